@@ -28,6 +28,9 @@
 /* Large Scale Captures. Disabled by default. */
 #define LARGE_SCALE 0
 
+/* Load the large fuseki databases at runtime. Disabled by default. */
+#cmakedefine01 LAZY_FUSEKI
+
 /* Oracle. Default not enabled. */
 #define ORACLE 0
 
@@ -53,6 +56,9 @@
 /* Define to 1 if you have the <curses.h> header file. */
 #cmakedefine HAVE_CURSES_H 1
 
+/* Define to 1 if you have the `fork' function. */
+#cmakedefine HAVE_FORK 1
+
 /* Define to 1 if you have the `gettimeofday' function. */
 #cmakedefine HAVE_GETTIMEOFDAY 1
 
@@ -62,12 +68,18 @@
 /* Define to 1 if you have the `g_vsnprintf' function. */
 #cmakedefine HAVE_G_VSNPRINTF 1
 
+/* Define to 1 if you have the `mmap' function. */
+#cmakedefine HAVE_MMAP 1
+
 /* Define to 1 if you have the <ncurses/curses.h> header file. */
 #cmakedefine HAVE_NCURSES_CURSES_H 1
 
 /* Define to 1 if you have the <ncurses/term.h> header file. */
 #cmakedefine HAVE_NCURSES_TERM_H 1
 
+/* Define to 1 if you have the `pthread_create' function. */
+#cmakedefine HAVE_PTHREAD_CREATE 1
+
 /* Define to 1 if you have the <sys/times.h> header file. */
 #cmakedefine HAVE_SYS_TIMES_H 1
 
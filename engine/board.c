@@ -33,6 +33,7 @@
 #include "hash.h"
 #include "sgftree.h"
 #include "gg_utils.h"
+#include "dfa.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -123,10 +124,27 @@ struct vertex_stack_entry {
   change_stack_pointer->value
 
 
+/* Mirror the new value of board[pos] on the dfa boards. The second
+ * one sees the board from black's side, with the colors swapped.
+ */
+#define DFA_SET_VERTEX(pos, value)\
+  do {\
+    int dfa_index = DFA_POS(I(pos), J(pos));\
+    int dfa_value = (value);\
+    dfa_board[0][dfa_index] = dfa_value;\
+    dfa_board[1][dfa_index] = (IS_STONE(dfa_value) ?\
+                               OTHER_COLOR(dfa_value) : dfa_value);\
+  } while (0)
+
+/* The vertex stack only holds board[] entries, so the dfa boards
+ * can be restored along with them.
+ */
 #define POP_VERTICES()\
-  while ((--vertex_stack_pointer)->address)\
-  *(vertex_stack_pointer->address) =\
-  vertex_stack_pointer->value
+  while ((--vertex_stack_pointer)->address) {\
+    *(vertex_stack_pointer->address) = vertex_stack_pointer->value;\
+    DFA_SET_VERTEX(vertex_stack_pointer->address - board,\
+                   vertex_stack_pointer->value);\
+  }
 
 
 /* ================================================================ */
@@ -275,6 +293,7 @@ static int next_stone[BOARDMAX];
   do {\
     PUSH_VERTEX(board[pos]);\
     board[pos] = color;\
+    DFA_SET_VERTEX(pos, color);\
     hashdata_invert_stone(&board_hash, pos, color);\
   } while (0)
 
@@ -283,6 +302,7 @@ static int next_stone[BOARDMAX];
     PUSH_VERTEX(board[pos]);\
     hashdata_invert_stone(&board_hash, pos, board[pos]);\
     board[pos] = EMPTY;\
+    DFA_SET_VERTEX(pos, EMPTY);\
   } while (0)
 
 
@@ -293,6 +313,9 @@ static int next_stone[BOARDMAX];
 /* Number of the next free string. */
 static int next_string;
 
+/* Board size the border of the dfa boards was set up for. */
+static int dfa_board_size = -1;
+
 
 /* For marking purposes. */
 static int ml[BOARDMAX];
@@ -317,6 +340,7 @@ static void find_liberties_and_neighbors(int s);
 static int do_remove_string(int s);
 static void do_commit_suicide(int pos, int color);
 static void do_play_move(int pos, int color);
+static void clear_undo_history(void);
 
 static int komaster, kom_pos;
 
@@ -403,6 +427,7 @@ restore_board(struct board_state *state)
     move_history_pos[k] = state->move_history_pos[k];
     move_history_hash[k] = state->move_history_hash[k];
   }
+  clear_undo_history();
 
   komi = state->komi;
   handicap = state->handicap;
@@ -445,6 +470,7 @@ clear_board(void)
   initial_black_captured = 0;
 
   move_history_pointer = 0;
+  clear_undo_history();
   movenum = 0;
 
   handicap = 0;
@@ -810,6 +836,39 @@ do_dump_stack(void)
 /* ================================================================ */
 
 
+/* Undo information for the moves in the move history, which lets
+ * undo_move() take back moves without replaying the game from the
+ * initial position. move_undo[k] holds the ko position and capture
+ * counts from before move k, and the stones captured by the move are
+ * the entries of undo_captures[] from move_undo[k].first_capture up to
+ * move_undo[k + 1].first_capture. Only the moves from
+ * undo_history_start on have this information.
+ */
+#define MAX_UNDO_CAPTURES (4 * MAX_MOVE_HISTORY)
+
+static struct {
+  int ko_pos;
+  int white_captured;
+  int black_captured;
+  int first_capture;
+} move_undo[MAX_MOVE_HISTORY + 1];
+
+static struct {
+  int pos;
+  int color;
+} undo_captures[MAX_UNDO_CAPTURES];
+
+static int undo_history_start;
+
+
+/* Drop the undo information for the moves played so far. */
+static void
+clear_undo_history(void)
+{
+  undo_history_start = move_history_pointer;
+  move_undo[move_history_pointer].first_capture = 0;
+}
+
 static void
 reset_move_history(void)
 {
@@ -818,6 +877,7 @@ reset_move_history(void)
   initial_white_captured = white_captured;
   initial_black_captured = black_captured;
   move_history_pointer = 0;
+  clear_undo_history();
 }
 
 /* Place a stone on the board and update the board_hash. This operation
@@ -912,6 +972,7 @@ replay_move_history(int n)
   board_ko_pos = initial_board_ko_pos;
   white_captured = initial_white_captured;
   black_captured = initial_black_captured;
+  hashdata_recalc(&board_hash, board, board_ko_pos);
   new_position();
 
   for (k = 0; k < n; k++)
@@ -937,6 +998,10 @@ replay_move_history(int n)
 void
 play_move(int pos, int color)
 {
+  Intersection board_before[BOARDSIZE];
+  int first_capture;
+  int k;
+
   ASSERT1(stackp == 0, pos);
   ASSERT1(color == WHITE || color == BLACK, pos);
   ASSERT1(pos == PASS_MOVE || ON_BOARD1(pos), pos);
@@ -948,7 +1013,6 @@ play_move(int pos, int color)
      * first about 10% of the moves into the initial position.
      */
     int number_collapsed_moves = 1 + MAX_MOVE_HISTORY / 10;
-    int k;
     Intersection saved_board[BOARDSIZE];
     int saved_board_ko_pos = board_ko_pos;
     int saved_white_captured = white_captured;
@@ -973,7 +1037,9 @@ play_move(int pos, int color)
     board_ko_pos = saved_board_ko_pos;
     white_captured = saved_white_captured;
     black_captured = saved_black_captured;
+    hashdata_recalc(&board_hash, board, board_ko_pos);
     new_position();
+    clear_undo_history();
   }
 
   move_history_color[move_history_pointer] = color;
@@ -981,16 +1047,42 @@ play_move(int pos, int color)
   move_history_hash[move_history_pointer] = board_hash;
   if (board_ko_pos != NO_MOVE)
     hashdata_invert_ko(&move_history_hash[move_history_pointer], board_ko_pos);
+
+  move_undo[move_history_pointer].ko_pos = board_ko_pos;
+  move_undo[move_history_pointer].white_captured = white_captured;
+  move_undo[move_history_pointer].black_captured = black_captured;
+  memcpy(board_before, board, sizeof(board));
+
   move_history_pointer++;
   
   play_move_no_history(pos, color, 1);
+
+  /* Record the stones removed by the move. If there is no room left,
+   * the moves up to this one can only be undone by a replay.
+   */
+  first_capture = move_undo[move_history_pointer - 1].first_capture;
+  for (k = BOARDMIN; k < BOARDMAX; k++) {
+    if (IS_STONE(board_before[k]) && board[k] == EMPTY) {
+      if (first_capture == MAX_UNDO_CAPTURES)
+	break;
+      undo_captures[first_capture].pos = k;
+      undo_captures[first_capture].color = board_before[k];
+      first_capture++;
+    }
+  }
+  if (k < BOARDMAX)
+    clear_undo_history();
+  else
+    move_undo[move_history_pointer].first_capture = first_capture;
   
   movenum++;
 }
 
 
 /* Undo n permanent moves. Returns 1 if successful and 0 if it fails.
- * If n moves cannot be undone, no move is undone.
+ * If n moves cannot be undone, no move is undone. The moves are taken
+ * back one by one when they have undo information, otherwise the
+ * remaining moves are replayed from the initial position.
  */
 int
 undo_move(int n)
@@ -1001,9 +1093,33 @@ undo_move(int n)
   if (move_history_pointer < n)
     return 0;
 
-  replay_move_history(move_history_pointer - n);
+  if (n == 0)
+    return 1;
+
+  if (move_history_pointer - n >= undo_history_start) {
+    /* Take back the moves one at a time. */
+    int k;
+    int i;
+    for (k = move_history_pointer - 1; k >= move_history_pointer - n; k--) {
+      if (move_history_pos[k] != PASS_MOVE)
+	board[move_history_pos[k]] = EMPTY;
+      for (i = move_undo[k].first_capture;
+	   i < move_undo[k + 1].first_capture; i++)
+	board[undo_captures[i].pos] = undo_captures[i].color;
+      board_ko_pos = move_undo[k].ko_pos;
+      white_captured = move_undo[k].white_captured;
+      black_captured = move_undo[k].black_captured;
+    }
+    hashdata_recalc(&board_hash, board, board_ko_pos);
+    new_position();
+  }
+  else
+    replay_move_history(move_history_pointer - n);
+
   move_history_pointer -= n;
   movenum -= n;
+  if (undo_history_start > move_history_pointer)
+    clear_undo_history();
 
   return 1;
 }
@@ -3308,6 +3424,15 @@ new_position(void)
   string_mark = 0;
   CLEAR_STACKS();
 
+  /* Rebuild the dfa boards, with a fresh border if the size changed. */
+  if (dfa_board_size != board_size) {
+    memset(dfa_board, OUT_BOARD, sizeof(dfa_board));
+    dfa_board_size = board_size;
+  }
+  for (pos = BOARDMIN; pos < BOARDMAX; pos++)
+    if (ON_BOARD(pos))
+      DFA_SET_VERTEX(pos, board[pos]);
+
   memset(string, 0, sizeof(string));
   memset(string_libs, 0, sizeof(string_libs));
   memset(string_neighbors, 0, sizeof(string_neighbors));
@@ -26,6 +26,7 @@
 
 #include "board.h"
 #include "hash.h"
+#include "dfa.h"
 
 /* The board state itself. */
 int          board_size = DEFAULT_BOARD_SIZE; /* board size */
@@ -43,6 +44,9 @@ int          move_history_pos[MAX_MOVE_HISTORY];
 Hash_data    move_history_hash[MAX_MOVE_HISTORY];
 int          move_history_pointer;
 
+/* The board as seen by the dfa matcher, kept in sync by board.c. */
+Intersection dfa_board[2][DFA_BASE * DFA_BASE];
+
 float komi = 0.0;
 int handicap = 0;
 int movenum;
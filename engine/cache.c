@@ -30,6 +30,10 @@
 #include <limits.h>
 #include <string.h>
 
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
 #include "liberty.h"
 #include "cache.h"
 #include "sgftree.h"
@@ -39,8 +43,31 @@
 /*                    The transposition table                       */
 /* ---------------------------------------------------------------- */
 
+/* Entries are aligned to this, see tt_allocate(). */
+#define TT_CACHE_LINE_SIZE 64
+
+/* Compile time check that entries tile the cache lines. */
+typedef char tt_entry_size_check[(TT_CACHE_LINE_SIZE % sizeof(Hashentry)
+				  == 0) ? 1 : -1];
+
+/* Number of moves a result stays valid when the cache is reused
+ * between moves, see tt_new_move().
+ */
+#define TT_MAX_AGE 4
+
+/* Only the tactical reading results depend on nothing but the board
+ * and the settings. The owl, semeai and connection results also
+ * depend on the dragon data of the position the move was generated
+ * in, so they are only valid during the move they were read in.
+ */
+#define TT_KEPT_BETWEEN_MOVES(routine) \
+  ((routine) == ATTACK || (routine) == FIND_DEFENSE)
+
 static void tt_init(Transposition_table *table, int memsize);
 static void tt_clear(Transposition_table *table);
+static void tt_next_generation(Transposition_table *table);
+static Hashentry *tt_allocate(int num_entries, int shared, void **memory);
+static void tt_release(void *memory, int num_entries, int shared);
 
 /* The transposition table itself. */
 Transposition_table ttable;
@@ -54,7 +81,7 @@ static Hash_data target1_hash[BOARDMAX];
 static Hash_data target2_hash[BOARDMAX];
 static Hash_data routine_hash[NUM_CACHE_ROUTINES];
 
-static void
+void
 keyhash_init(void)
 {
   static int is_initialized = 0;
@@ -69,11 +96,18 @@ keyhash_init(void)
   }
 }
 
+/* Hash of the level and the reading depths and node limits the
+ * results were computed with, see reading_cache_set_depth_values().
+ * It stays zero unless the cache is reused between moves.
+ */
+static Hash_data settings_hash;
+
 static void
 calculate_hashval_for_tt(Hash_data *hashdata, int routine, int target1,
 			 int target2, Hash_data *extra_hash)
 { 
   *hashdata = board_hash;                /* from globals.c */
+  hashdata_xor(*hashdata, settings_hash);
   hashdata_xor(*hashdata, routine_hash[routine]);
   hashdata_xor(*hashdata, target1_hash[target1]);
   if (target2 != NO_MOVE)
@@ -85,7 +119,9 @@ calculate_hashval_for_tt(Hash_data *hashdata, int routine, int target1,
 
 
 /* Initialize the transposition table. Non-positive memsize means use
- * the default size of DEFAULT_NUMBER_OF_CACHE_ENTRIES entries.
+ * the default size of DEFAULT_NUMBER_OF_CACHE_ENTRIES entries. If the
+ * table is already allocated with the same number of entries it is
+ * only cleared, otherwise it is reallocated.
  */
 
 static void
@@ -102,29 +138,77 @@ tt_init(Transposition_table *table, int memsize)
   else
     num_entries = DEFAULT_NUMBER_OF_CACHE_ENTRIES;
 
-  table->num_entries = num_entries;
-  table->entries     = malloc(num_entries * sizeof(table->entries[0]));
-
-  if (table->entries == NULL) {
-    perror("Couldn't allocate memory for transposition table. \n");
-    exit(1);
+  if (table->entries == NULL || table->num_entries != (unsigned) num_entries) {
+    int shared = table->is_shared;
+    tt_free(table);
+    table->num_entries = num_entries;
+    table->entries     = tt_allocate(num_entries, shared, &table->memory);
+    table->is_shared   = shared && table->entries != NULL;
+    if (shared && table->entries == NULL)
+      table->entries = tt_allocate(num_entries, 0, &table->memory);
+
+    if (table->entries == NULL) {
+      perror("Couldn't allocate memory for transposition table. \n");
+      exit(1);
+    }
+    /* The new entries are all zero, i.e. of no generation. */
+    table->generation = 1;
+    table->oldest_generation = 1;
+    table->is_clean = 1;
   }
 
-  table->is_clean = 0;
   tt_clear(table);
 }
 
 
-/* Clear the transposition table. */
+/* Clear the transposition table. Instead of writing zeros all over
+ * the table, we start a new generation. Nodes stored in earlier
+ * generations then read as empty nodes, see tt_load_node(). Only when
+ * the generation number runs out is the table actually cleared.
+ */
 
 static void
 tt_clear(Transposition_table *table)
 {
   if (!table->is_clean) {
-    memset(table->entries, 0, table->num_entries * sizeof(table->entries[0]));
+    tt_next_generation(table);
+    table->oldest_generation = table->generation;
     table->is_clean = 1;
   }
 }
+
+
+/* Start a new generation, or clear the table when the numbers run
+ * out.
+ */
+
+static void
+tt_next_generation(Transposition_table *table)
+{
+  if (table->generation < HN_MAX_GENERATION)
+    table->generation++;
+  else {
+    memset(table->entries, 0, table->num_entries * sizeof(table->entries[0]));
+    table->generation = 1;
+    table->oldest_generation = 1;
+  }
+}
+
+
+/* Start a new generation for a new move but keep the tactical results
+ * of the last TT_MAX_AGE - 1 moves valid. They are overwritten before
+ * the results of the current move, see tt_node_cost(). All other
+ * results of earlier generations read as empty nodes from now on, see
+ * tt_load_node().
+ */
+
+static void
+tt_new_move(Transposition_table *table)
+{
+  tt_next_generation(table);
+  table->oldest_generation = gg_max(table->oldest_generation,
+				    table->generation - TT_MAX_AGE + 1);
+}
  
  
 /* Free the transposition table. */
@@ -132,7 +216,160 @@ tt_clear(Transposition_table *table)
 void
 tt_free(Transposition_table *table)
 {
-  free(table->entries);
+  if (table->memory)
+    tt_release(table->memory, table->num_entries, table->is_shared);
+  table->memory = NULL;
+  table->entries = NULL;
+  table->num_entries = 0;
+  table->is_shared = 0;
+}
+
+
+/* Allocate zeroed entries for a table, in memory shared with processes
+ * forked later if shared is set. The entries are aligned to
+ * TT_CACHE_LINE_SIZE, and their size divides it, so that an entry
+ * never straddles two cache lines. *memory is set to what tt_release()
+ * needs. Returns NULL on failure.
+ */
+
+static Hashentry *
+tt_allocate(int num_entries, int shared, void **memory)
+{
+  char *entries;
+
+  if (shared) {
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+    /* The mapping is page aligned and zero filled. */
+    *memory = mmap(NULL, num_entries * sizeof(Hashentry),
+		   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+		   -1, 0);
+    if (*memory == MAP_FAILED) {
+      *memory = NULL;
+      return NULL;
+    }
+    return *memory;
+#else
+    return NULL;
+#endif
+  }
+
+  *memory = calloc(num_entries * sizeof(Hashentry) + TT_CACHE_LINE_SIZE, 1);
+  if (*memory == NULL)
+    return NULL;
+  entries = *memory;
+  entries += TT_CACHE_LINE_SIZE - (unsigned long) entries % TT_CACHE_LINE_SIZE;
+  return (Hashentry *) entries;
+}
+
+
+static void
+tt_release(void *memory, int num_entries, int shared)
+{
+#if HAVE_MMAP
+  if (shared) {
+    munmap(memory, num_entries * sizeof(Hashentry));
+    return;
+  }
+#else
+  UNUSED(num_entries);
+  UNUSED(shared);
+#endif
+  free(memory);
+}
+
+
+/* Move the table into memory shared with processes forked from now
+ * on, keeping its contents. Those processes and this one then probe
+ * and store into the same entries concurrently, see tt_load_node()
+ * and tt_store_node(). Returns 1 if the table is shared.
+ */
+
+static int
+tt_share(Transposition_table *table)
+{
+  Hashentry *entries;
+  void *memory;
+
+  if (table->is_shared)
+    return 1;
+  if (table->entries == NULL)
+    return 0;
+
+  entries = tt_allocate(table->num_entries, 1, &memory);
+  if (entries == NULL)
+    return 0;
+  memcpy(entries, table->entries,
+	 table->num_entries * sizeof(table->entries[0]));
+  tt_release(table->memory, table->num_entries, 0);
+  table->memory = memory;
+  table->entries = entries;
+  table->is_shared = 1;
+  return 1;
+}
+
+
+/* The nodes are stored with the data xored into the key. Another
+ * process may write the same node while we read it, or both may write
+ * it at the same time, so that we get the key of one result and the
+ * data of another. Then the key doesn't match after xoring out the
+ * data and the node is just not found, without any locking.
+ *
+ * tt_load_node() copies a node out of the table and undoes the xor.
+ * A node from a generation that is no longer valid comes out as an
+ * empty node, just as if the table had been cleared. So does a node
+ * of an earlier move, unless it is read for a routine whose results
+ * are kept between moves. tt_store_node()
+ * does the opposite, tagging the node with the current generation.
+ */
+
+static void
+tt_load_node(Transposition_table *table, enum routine_id routine,
+	     const Hashnode *stored, Hashnode *node)
+{
+  const volatile Hashnode *source = stored;
+  int generation;
+  int k;
+
+  node->data = source->data;
+  generation = hn_get_generation(node->data);
+  if (generation < table->oldest_generation
+      || generation > table->generation
+      || (generation < table->generation
+	  && !TT_KEPT_BETWEEN_MOVES(routine))) {
+    memset(node, 0, sizeof(*node));
+    return;
+  }
+  for (k = 0; k < NUM_HASHVALUES; k++)
+    node->key.hashval[k] = source->key.hashval[k];
+  node->key.hashval[0] ^= node->data;
+}
+
+static void
+tt_store_node(Transposition_table *table, Hashnode *stored,
+	      const Hashnode *node)
+{
+  volatile Hashnode *target = stored;
+  unsigned int data = hn_set_generation(node->data, table->generation);
+  int k;
+
+  target->data = data;
+  target->key.hashval[0] = node->key.hashval[0] ^ data;
+  for (k = 1; k < NUM_HASHVALUES; k++)
+    target->key.hashval[k] = node->key.hashval[k];
+}
+
+
+/* The cost of recomputing the result of a node, for deciding which
+ * node to replace. Results kept from earlier moves are replaced
+ * first.
+ */
+
+static int
+tt_node_cost(Transposition_table *table, Hashnode *node)
+{
+  if ((int) hn_get_generation(node->data) != table->generation)
+    return 0;
+  return hn_get_total_cost(node->data);
 }
 
 
@@ -152,6 +389,8 @@ tt_get(Transposition_table *table,
 {
   Hash_data hashval;
   Hashentry *entry;
+  Hashnode deepest;
+  Hashnode newest;
   Hashnode *node;
  
   /* Sanity check. */
@@ -163,10 +402,12 @@ tt_get(Transposition_table *table,
 
   /* Get the correct entry and node. */
   entry = &table->entries[hashdata_remainder(hashval, table->num_entries)];
-  if (hashdata_is_equal(hashval, entry->deepest.key))
-    node = &entry->deepest;
-  else if (hashdata_is_equal(hashval, entry->newest.key))
-    node = &entry->newest;
+  tt_load_node(table, routine, &entry->deepest, &deepest);
+  tt_load_node(table, routine, &entry->newest, &newest);
+  if (hashdata_is_equal(hashval, deepest.key))
+    node = &deepest;
+  else if (hashdata_is_equal(hashval, newest.key))
+    node = &newest;
   else
     return 0;
 
@@ -202,8 +443,10 @@ tt_update(Transposition_table *table,
 {
   Hash_data hashval;
   Hashentry *entry;
-  Hashnode *deepest;
-  Hashnode *newest;
+  Hashnode deepest_node;
+  Hashnode newest_node;
+  Hashnode *deepest = &deepest_node;
+  Hashnode *newest = &newest_node;
   unsigned int data;
   /* Get routine costs definitions from liberty.h. */
   static const int routine_costs[] = { ROUTINE_COSTS };
@@ -221,8 +464,8 @@ tt_update(Transposition_table *table,
 
   /* Get the entry and nodes. */ 
   entry = &table->entries[hashdata_remainder(hashval, table->num_entries)];
-  deepest = &entry->deepest;
-  newest  = &entry->newest;
+  tt_load_node(table, routine, &entry->deepest, deepest);
+  tt_load_node(table, routine, &entry->newest, newest);
  
   /* See if we found an already existing node. */
   if (hashdata_is_equal(hashval, deepest->key)
@@ -230,6 +473,7 @@ tt_update(Transposition_table *table,
 
     /* Found deepest */
     deepest->data = data;
+    tt_store_node(table, &entry->deepest, deepest);
 
   }
   else if (hashdata_is_equal(hashval, newest->key)
@@ -241,24 +485,25 @@ tt_update(Transposition_table *table,
     /* If newest has become deeper than deepest, then switch them. */
     if (hn_get_remaining_depth(newest->data)
 	> hn_get_remaining_depth(deepest->data)) {
-      Hashnode temp;
-
-      temp = *deepest;
-      *deepest = *newest;
-      *newest = temp;
+      tt_store_node(table, &entry->deepest, newest);
+      tt_store_node(table, &entry->newest, deepest);
     }
+    else
+      tt_store_node(table, &entry->newest, newest);
 
   }
-  else if (hn_get_total_cost(data) > hn_get_total_cost(deepest->data)) {
-    if (hn_get_total_cost(newest->data) < hn_get_total_cost(deepest->data))
-      *newest = *deepest;
+  else if ((int) hn_get_total_cost(data) > tt_node_cost(table, deepest)) {
+    if (tt_node_cost(table, newest) < tt_node_cost(table, deepest))
+      tt_store_node(table, &entry->newest, deepest);
     deepest->key  = hashval;
     deepest->data = data;
+    tt_store_node(table, &entry->deepest, deepest);
   } 
   else {
     /* Replace newest. */
     newest->key  = hashval;
     newest->data = data;
+    tt_store_node(table, &entry->newest, newest);
   }
 
   stats.read_result_entered++;
@@ -281,7 +526,8 @@ routine_id_to_string(enum routine_id routine)
 /* Initialize the cache for read results, using at most the given
  * number of bytes of memory. If the memory isn't sufficient to
  * allocate a single node or if the allocation fails, the caching is
- * disabled.
+ * disabled. Calling this again reuses the existing table unless the
+ * size changes.
  */
 void
 reading_cache_init(int bytes)
@@ -297,6 +543,72 @@ reading_cache_clear()
   tt_clear(&ttable);
 }
 
+
+/* Start reading for a new move. Results from the last few moves stay
+ * valid if the cache is reused between moves, otherwise the cache is
+ * cleared.
+ */
+void
+reading_cache_new_move()
+{
+  if (reuse_reading_cache)
+    tt_new_move(&ttable);
+  else
+    tt_clear(&ttable);
+}
+
+
+/* Called when the level and the depth values have been set up for a
+ * new move. If the cache is reused between moves, these settings go
+ * into the key of every result, so that results read with other
+ * settings are not found. Temporary depth modifications during the
+ * move are covered by the remaining depth stored with each result, as
+ * before.
+ */
+void
+reading_cache_set_depth_values()
+{
+  int settings[] = {
+    get_level(), depth, branch_depth, backfill_depth, backfill2_depth,
+    break_chain_depth, superstring_depth, fourlib_depth, ko_depth,
+    aa_depth, owl_distrust_depth, owl_branch_depth, owl_reading_depth,
+    owl_node_limit, semeai_branch_depth, semeai_branch_depth2,
+    semeai_node_limit, connect_depth, connect_depth2,
+    connection_node_limit, breakin_depth, breakin_node_limit
+  };
+  int k;
+  int j;
+
+  hashdata_clear(&settings_hash);
+  if (!reuse_reading_cache)
+    return;
+
+  /* Mix the values into each word. The multiplier is odd, so
+   * different settings practically never give the same hash.
+   */
+  for (j = 0; j < NUM_HASHVALUES; j++) {
+    Hashvalue h = j + 1;
+    for (k = 0; k < (int) (sizeof(settings) / sizeof(settings[0])); k++) {
+      h = (h ^ (Hashvalue) settings[k]) * 0x9e3779b1UL;
+      h ^= h >> 15;
+    }
+    settings_hash.hashval[j] = h;
+  }
+}
+
+
+/* Let processes forked from now on share the cache for read results
+ * with this one, see analyze_in_processes(). Returns 1 if the cache
+ * is shared.
+ */
+int
+reading_cache_share()
+{
+  /* What the other processes store can't be seen in is_clean. */
+  ttable.is_clean = 0;
+  return tt_share(&ttable);
+}
+
 float
 reading_cache_default_size()
 {
@@ -48,7 +48,7 @@
  * The data field packs into 32 bits the following
  * fields:
  *
- *   RESERVED       :  5 bits
+ *   generation     :  5 bits  (set by the table, see tt_clear())
  *   value1         :  4 bits
  *   value2         :  4 bits
  *   move           : 10 bits
@@ -63,13 +63,28 @@ typedef struct {
 } Hashnode;
 
 #define HN_MAX_REMAINING_DEPTH 31
+#define HN_MAX_GENERATION 31
 
 
-/* Hashentry: an entry, with two nodes of the hash_table
+/* Hashentry: an entry, with two nodes of the hash_table. A node takes
+ * the hash values and the data word, padded to the alignment of the
+ * hash values, i.e. one more hash value. The entry is padded to 32 or
+ * 64 bytes so that an aligned entry sits in a single cache line also
+ * when the hash values are 32 bit longs, see tt_allocate().
  */
+#define HN_SIZE ((NUM_HASHVALUES + 1) * SIZEOF_HASHVALUE)
+#if 2 * HN_SIZE <= 32
+#define HASHENTRY_SIZE 32
+#else
+#define HASHENTRY_SIZE 64
+#endif
+
 typedef struct {
   Hashnode deepest;
   Hashnode newest;
+#if HASHENTRY_SIZE > 2 * HN_SIZE
+  char padding[HASHENTRY_SIZE - 2 * HN_SIZE];
+#endif
 } Hashentry;
 
 /* Hn is for hash node. */
@@ -79,6 +94,10 @@ typedef struct {
 #define hn_get_cost(hn)             ((hn >>  5) & 0x0f)
 #define hn_get_remaining_depth(hn)  ((hn >>  0) & 0x1f)
 #define hn_get_total_cost(hn)       ((hn >>  0) & 0x1ff)
+#define hn_get_generation(hn)       ((hn >> 27) & 0x1f)
+
+#define hn_set_generation(hn, generation) \
+    (((hn) & ~(0x1fU << 27)) | (((generation) & 0x1f) << 27))
 
 #define hn_create_data(remaining_depth, value1, value2, move, cost) \
     ((((value1)         & 0x0f)  << 23) \
@@ -92,7 +111,11 @@ typedef struct {
 typedef struct {
   unsigned int num_entries;
   Hashentry *entries;
+  void *memory;        /* the allocation holding the entries */
   int is_clean;
+  int is_shared;  /* entries are in memory shared with forked processes */
+  int generation; /* the generation stored nodes are tagged with */
+  int oldest_generation; /* nodes of older generations are invalid */
 } Transposition_table;
 
 extern Transposition_table ttable;
@@ -72,6 +72,9 @@ static enum dragon_status compute_crude_status(int pos);
 static int compute_escape(int pos, int dragon_status_known);
 static void compute_surrounding_moyo_sizes(const struct influence_data *q);
 static void clear_cut_list(void);
+static void owl_analyze_dragon(int str);
+static void owl_threats_dragon(int str);
+static void for_each_dragon_origin(void (*analyze)(int str));
 
 static int dragon2_initialized;
 static int lively_white_dragons;
@@ -93,6 +96,186 @@ dragon2_func(int pos)
   return &dragon2[dragon[pos].id];
 }
 
+/* Copy the dragon2[] entry of the dragon at pos out of and back into
+ * a worker process, see analyze_in_processes().
+ */
+static void
+export_dragon2(int pos, void *result)
+{
+  memcpy(result, &DRAGON2(pos), sizeof(struct dragon_data2));
+}
+
+static void
+import_dragon2(int pos, const void *result)
+{
+  memcpy(&DRAGON2(pos), result, sizeof(struct dragon_data2));
+}
+
+/* Call analyze() for the origin of every dragon, in board order or,
+ * with owl_jobs > 1, spread over several processes.
+ */
+static void
+for_each_dragon_origin(void (*analyze)(int str))
+{
+  int origins[BOARDMAX];
+  int num_origins = 0;
+  int pos;
+
+  for (pos = BOARDMIN; pos < BOARDMAX; pos++)
+    if (IS_STONE(board[pos]) && dragon[pos].origin == pos)
+      origins[num_origins++] = pos;
+
+  analyze_in_processes(owl_jobs, origins, num_origins, analyze,
+		       sizeof(struct dragon_data2),
+		       export_dragon2, import_dragon2);
+}
+
+/* Determine the owl status of the dragon with origin str, with the
+ * attack and defense points.
+ */
+static void
+owl_analyze_dragon(int str)
+{
+  int attack_point = NO_MOVE;
+  int defense_point = NO_MOVE;
+  struct eyevalue no_eyes;
+  set_eyevalue(&no_eyes, 0, 0, 0, 0);
+
+  /* Some dragons can be ignored but be extra careful with big dragons. */
+  if (crude_dragon_weakness(ALIVE, &no_eyes, 0,
+			    DRAGON2(str).moyo_territorial_value,
+			    DRAGON2(str).escape_route - 10)
+      < 0.00001 + gg_max(0.12, 0.32 - 0.01*dragon[str].effective_size)) {
+    DRAGON2(str).owl_status = UNCHECKED;
+    DRAGON2(str).owl_attack_point  = NO_MOVE;
+    DRAGON2(str).owl_defense_point = NO_MOVE;
+  }
+  else {
+    int acode = 0;
+    int dcode = 0;
+    int kworm = NO_MOVE;
+    int owl_nodes_before = get_owl_node_counter();
+    start_timer(3);
+    acode = owl_attack(str, &attack_point, 
+		       &DRAGON2(str).owl_attack_certain, &kworm);
+    DRAGON2(str).owl_attack_node_count
+      = get_owl_node_counter() - owl_nodes_before;
+    if (acode != 0) {
+      DRAGON2(str).owl_attack_point = attack_point;
+      DRAGON2(str).owl_attack_code = acode;
+      DRAGON2(str).owl_attack_kworm = kworm;
+      if (attack_point != NO_MOVE) {
+	kworm = NO_MOVE;
+	dcode = owl_defend(str, &defense_point,
+			   &DRAGON2(str).owl_defense_certain, &kworm);
+	if (dcode != 0) {
+	  if (defense_point != NO_MOVE) {
+	    DRAGON2(str).owl_status = (acode == GAIN ? ALIVE : CRITICAL);
+	    DRAGON2(str).owl_defense_point = defense_point;
+	    DRAGON2(str).owl_defense_code = dcode;
+	    DRAGON2(str).owl_defense_kworm = kworm;
+	  }
+	  else {
+	    /* Due to irregularities in the owl code, it may
+	     * occasionally happen that a dragon is found to be
+	     * attackable but also alive as it stands. In this case
+	     * we still choose to say that the owl_status is
+	     * CRITICAL, although we don't have any defense move to
+	     * propose. Having the status right is important e.g.
+	     * for connection moves to be properly valued.
+	     */
+	    DRAGON2(str).owl_status = (acode == GAIN ? ALIVE : CRITICAL);
+	    DEBUG(DEBUG_OWL_PERFORMANCE,
+		  "Inconsistent owl attack and defense results for %1m.\n", 
+		  str);
+	    /* Let's see whether the attacking move might be the right
+	     * defense:
+	     */
+	    dcode = owl_does_defend(DRAGON2(str).owl_attack_point,
+				    str, NULL);
+	    if (dcode != 0) {
+	      DRAGON2(str).owl_defense_point
+		= DRAGON2(str).owl_attack_point;
+	      DRAGON2(str).owl_defense_code = dcode;
+	    }
+	  }
+	}
+      }
+      if (dcode == 0) {
+	DRAGON2(str).owl_status = DEAD; 
+	DRAGON2(str).owl_defense_point = NO_MOVE;
+	DRAGON2(str).owl_defense_code = 0;
+      }
+    }
+    else {
+      if (!DRAGON2(str).owl_attack_certain) {
+	kworm = NO_MOVE;
+	dcode = owl_defend(str, &defense_point, 
+			   &DRAGON2(str).owl_defense_certain, &kworm);
+	if (dcode != 0) {
+	  /* If the result of owl_attack was not certain, we may
+	   * still want the result of owl_defend */
+	  DRAGON2(str).owl_defense_point = defense_point;
+	  DRAGON2(str).owl_defense_code = dcode;
+	  DRAGON2(str).owl_defense_kworm = kworm;
+	}
+      }
+      DRAGON2(str).owl_status = ALIVE;
+      DRAGON2(str).owl_attack_point = NO_MOVE;
+      DRAGON2(str).owl_attack_code = 0;
+
+    }
+  }
+}
+
+/* Look for owl threats against or for the dragon with origin str. */
+static void
+owl_threats_dragon(int str)
+{
+  struct eyevalue no_eyes;
+  set_eyevalue(&no_eyes, 0, 0, 0, 0);
+  if (crude_dragon_weakness(ALIVE, &no_eyes, 0,
+			    DRAGON2(str).moyo_territorial_value,
+			    DRAGON2(str).escape_route - 10)
+      < 0.00001 + gg_max(0.12, 0.32 - 0.01*dragon[str].effective_size)) {
+    DRAGON2(str).owl_threat_status = UNCHECKED;
+    DRAGON2(str).owl_second_attack_point  = NO_MOVE;
+    DRAGON2(str).owl_second_defense_point = NO_MOVE;
+  }
+  else {
+    int acode = DRAGON2(str).owl_attack_code;
+    int dcode = DRAGON2(str).owl_defense_code;
+    int defense_point, second_defense_point;
+
+    if (get_level() >= 8
+	&& !disable_threat_computation
+	&& (owl_threats 
+	    || thrashing_stone[str])) {
+      if (acode && !dcode && DRAGON2(str).owl_attack_point != NO_MOVE) {
+	if (owl_threaten_defense(str, &defense_point,
+				 &second_defense_point)) {
+	  DRAGON2(str).owl_threat_status = CAN_THREATEN_DEFENSE;
+	  DRAGON2(str).owl_defense_point = defense_point;
+	  DRAGON2(str).owl_second_defense_point = second_defense_point;
+	}
+	else
+	  DRAGON2(str).owl_threat_status = DEAD;
+      }
+      else if (!acode) {
+	int attack_point, second_attack_point;
+	if (owl_threaten_attack(str, 
+				&attack_point, &second_attack_point)) {
+	  DRAGON2(str).owl_threat_status = CAN_THREATEN_ATTACK;
+	  DRAGON2(str).owl_attack_point = attack_point;
+	  DRAGON2(str).owl_second_attack_point = second_attack_point;
+	}
+	else
+	  DRAGON2(str).owl_threat_status = ALIVE;
+      }
+    }
+  }
+}
+
 /* This basic function finds all dragons and collects some basic information
  * about them in the dragon array.
  *
@@ -193,103 +376,7 @@ make_dragons(int stop_before_owl)
    * if necessary.
    */
   start_timer(2);
-  for (str = BOARDMIN; str < BOARDMAX; str++)
-    if (ON_BOARD(str)) {
-      int attack_point = NO_MOVE;
-      int defense_point = NO_MOVE;
-      struct eyevalue no_eyes;
-      set_eyevalue(&no_eyes, 0, 0, 0, 0);
-      
-      if (board[str] == EMPTY
-	  || dragon[str].origin != str)
-	continue;
-      
-      /* Some dragons can be ignored but be extra careful with big dragons. */
-      if (crude_dragon_weakness(ALIVE, &no_eyes, 0,
-	    			DRAGON2(str).moyo_territorial_value,
-				DRAGON2(str).escape_route - 10)
-	  < 0.00001 + gg_max(0.12, 0.32 - 0.01*dragon[str].effective_size)) {
-	DRAGON2(str).owl_status = UNCHECKED;
-	DRAGON2(str).owl_attack_point  = NO_MOVE;
-	DRAGON2(str).owl_defense_point = NO_MOVE;
-      }
-      else {
-	int acode = 0;
-	int dcode = 0;
-	int kworm = NO_MOVE;
-	int owl_nodes_before = get_owl_node_counter();
-	start_timer(3);
-	acode = owl_attack(str, &attack_point, 
-			   &DRAGON2(str).owl_attack_certain, &kworm);
-	DRAGON2(str).owl_attack_node_count
-	  = get_owl_node_counter() - owl_nodes_before;
-	if (acode != 0) {
-	  DRAGON2(str).owl_attack_point = attack_point;
-	  DRAGON2(str).owl_attack_code = acode;
-	  DRAGON2(str).owl_attack_kworm = kworm;
-	  if (attack_point != NO_MOVE) {
-	    kworm = NO_MOVE;
-	    dcode = owl_defend(str, &defense_point,
-			       &DRAGON2(str).owl_defense_certain, &kworm);
-	    if (dcode != 0) {
-	      if (defense_point != NO_MOVE) {
-		DRAGON2(str).owl_status = (acode == GAIN ? ALIVE : CRITICAL);
-		DRAGON2(str).owl_defense_point = defense_point;
-		DRAGON2(str).owl_defense_code = dcode;
-		DRAGON2(str).owl_defense_kworm = kworm;
-	      }
-	      else {
-		/* Due to irregularities in the owl code, it may
-		 * occasionally happen that a dragon is found to be
-		 * attackable but also alive as it stands. In this case
-		 * we still choose to say that the owl_status is
-		 * CRITICAL, although we don't have any defense move to
-		 * propose. Having the status right is important e.g.
-		 * for connection moves to be properly valued.
-		 */
-		DRAGON2(str).owl_status = (acode == GAIN ? ALIVE : CRITICAL);
-		DEBUG(DEBUG_OWL_PERFORMANCE,
-		      "Inconsistent owl attack and defense results for %1m.\n", 
-		      str);
-		/* Let's see whether the attacking move might be the right
-		 * defense:
-		 */
-		dcode = owl_does_defend(DRAGON2(str).owl_attack_point,
-					str, NULL);
-		if (dcode != 0) {
-		  DRAGON2(str).owl_defense_point
-		    = DRAGON2(str).owl_attack_point;
-		  DRAGON2(str).owl_defense_code = dcode;
-		}
-	      }
-	    }
-	  }
-	  if (dcode == 0) {
-	    DRAGON2(str).owl_status = DEAD; 
-	    DRAGON2(str).owl_defense_point = NO_MOVE;
-	    DRAGON2(str).owl_defense_code = 0;
-	  }
-	}
-	else {
-	  if (!DRAGON2(str).owl_attack_certain) {
-	    kworm = NO_MOVE;
-	    dcode = owl_defend(str, &defense_point, 
-			       &DRAGON2(str).owl_defense_certain, &kworm);
-	    if (dcode != 0) {
-	      /* If the result of owl_attack was not certain, we may
-	       * still want the result of owl_defend */
-	      DRAGON2(str).owl_defense_point = defense_point;
-	      DRAGON2(str).owl_defense_code = dcode;
-	      DRAGON2(str).owl_defense_kworm = kworm;
-	    }
-	  }
-	  DRAGON2(str).owl_status = ALIVE;
-	  DRAGON2(str).owl_attack_point = NO_MOVE;
-	  DRAGON2(str).owl_attack_code = 0;
-	  
-	}
-      }
-    }
+  for_each_dragon_origin(owl_analyze_dragon);
   time_report(2, "  owl reading", NO_MOVE, 1.0);
   
   /* Compute the status to be used by the matcher. We most trust the
@@ -315,53 +402,7 @@ make_dragons(int stop_before_owl)
   identify_thrashing_dragons();
   
   /* Owl threats. */
-  for (str = BOARDMIN; str < BOARDMAX; str++)
-    if (ON_BOARD(str) 
-	&& board[str] != EMPTY 
-	&& dragon[str].origin == str) {
-      struct eyevalue no_eyes;
-      set_eyevalue(&no_eyes, 0, 0, 0, 0);
-      if (crude_dragon_weakness(ALIVE, &no_eyes, 0,
-	    			DRAGON2(str).moyo_territorial_value,
-				DRAGON2(str).escape_route - 10)
-	  < 0.00001 + gg_max(0.12, 0.32 - 0.01*dragon[str].effective_size)) {
-	DRAGON2(str).owl_threat_status = UNCHECKED;
-	DRAGON2(str).owl_second_attack_point  = NO_MOVE;
-	DRAGON2(str).owl_second_defense_point = NO_MOVE;
-      }
-      else {
-	int acode = DRAGON2(str).owl_attack_code;
-	int dcode = DRAGON2(str).owl_defense_code;
-	int defense_point, second_defense_point;
-
-	if (get_level() >= 8
-	    && !disable_threat_computation
-	    && (owl_threats 
-		|| thrashing_stone[str])) {
-	  if (acode && !dcode && DRAGON2(str).owl_attack_point != NO_MOVE) {
-	    if (owl_threaten_defense(str, &defense_point,
-				     &second_defense_point)) {
-	      DRAGON2(str).owl_threat_status = CAN_THREATEN_DEFENSE;
-	      DRAGON2(str).owl_defense_point = defense_point;
-	      DRAGON2(str).owl_second_defense_point = second_defense_point;
-	    }
-	    else
-	      DRAGON2(str).owl_threat_status = DEAD;
-	  }
-	  else if (!acode) {
-	    int attack_point, second_attack_point;
-	    if (owl_threaten_attack(str, 
-				    &attack_point, &second_attack_point)) {
-	      DRAGON2(str).owl_threat_status = CAN_THREATEN_ATTACK;
-	      DRAGON2(str).owl_attack_point = attack_point;
-	      DRAGON2(str).owl_second_attack_point = second_attack_point;
-	    }
-	    else
-	      DRAGON2(str).owl_threat_status = ALIVE;
-	  }
-	}
-      }
-    }
+  for_each_dragon_origin(owl_threats_dragon);
   
   /* Once again, the dragon data is now correct at the origin of each dragon
    * but we need to copy it to every vertex.  
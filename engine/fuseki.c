@@ -25,6 +25,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "liberty.h"
 #include "patterns.h"
@@ -277,6 +278,164 @@ fuseki_callback(int move, struct fullboard_pattern *pattern, int ll)
   num_fuseki_moves++;
 }
 
+
+/* Fuseki databases loaded at runtime by load_fuseki_database(),
+ * indexed by board size, together with the buffers holding their
+ * pattern names. When configured with --enable-lazy-fuseki the
+ * compiled in 13x13 and 19x19 databases are empty and these are used
+ * instead.
+ */
+static struct fullboard_pattern *loaded_fuseki[MAX_BOARD + 1];
+static char *loaded_fuseki_names[MAX_BOARD + 1];
+
+/* Hash tables over the databases, indexed by board size. They are
+ * built when a database is first matched against.
+ */
+static struct fullboard_index fuseki_index[MAX_BOARD + 1];
+
+/* Size in bytes of the hash value in a binary fuseki record. */
+#define FUSEKI_HASH_BYTES ((NUM_HASHBITS + 7) / 8)
+
+/* Hash value, three integers and at least the NUL of the name. */
+#define FUSEKI_MIN_RECORD (FUSEKI_HASH_BYTES + 3 * 4 + 1)
+
+/* Return the compiled in database for the board size or NULL. */
+static struct fullboard_pattern *
+compiled_fuseki_database(int size)
+{
+  /* We only have databases for 9x9, 13x13 and 19x19. */
+  if (size == 9)
+    return fuseki9;
+  else if (size == 13)
+    return fuseki13;
+  else if (size == 19)
+    return fuseki19;
+  else
+    return NULL;
+}
+
+/* Return the database to match against for the board size, or NULL
+ * if there is none.
+ */
+static struct fullboard_pattern *
+get_fuseki_database(int size)
+{
+  struct fullboard_pattern *database = compiled_fuseki_database(size);
+
+  if (database && !database->name)
+    database = loaded_fuseki[size];
+  return database;
+}
+
+/* Return 1 if there is a database for the board size which has been
+ * left out of the build and not loaded yet, 0 otherwise.
+ */
+int
+need_fuseki_database(int size)
+{
+  struct fullboard_pattern *database = compiled_fuseki_database(size);
+
+  return database && !database->name && !loaded_fuseki[size];
+}
+
+static int
+read_bin_int(const unsigned char *p)
+{
+  return (int) (((unsigned int) p[0] << 24) | ((unsigned int) p[1] << 16)
+		| ((unsigned int) p[2] << 8) | (unsigned int) p[3]);
+}
+
+/* Load a fuseki database in the binary format written by
+ * "uncompress_fuseki <size> <file> bin". The data is copied, so the
+ * caller may free it afterwards. A database already loaded for the
+ * same board size is replaced. Return the board size of the database
+ * or 0 if the data is malformed.
+ */
+int
+load_fuseki_database(const char *data, int length)
+{
+  char *names;
+  const unsigned char *p;
+  const unsigned char *end;
+  struct fullboard_pattern *database;
+  int bits_in_hashvalue = CHAR_BIT * SIZEOF_HASHVALUE;
+  int size;
+  int count;
+  int n;
+  int k;
+
+  if (length <= 0)
+    return 0;
+
+  /* Keep a NUL terminated copy, the names point into it. */
+  names = malloc(length + 1);
+  if (!names)
+    return 0;
+  memcpy(names, data, length);
+  names[length] = '\0';
+
+  p = (const unsigned char *) memchr(names, '\n', length);
+  if (!p || sscanf(names, "GNU Go fuseki %d", &size) != 1
+      || size < 1 || size > MAX_BOARD) {
+    free(names);
+    return 0;
+  }
+  p++;
+  end = (const unsigned char *) names + length;
+
+  /* Count the records and check that they are complete. */
+  count = 0;
+  while (p < end) {
+    if (end - p < FUSEKI_MIN_RECORD)
+      break;
+    p += FUSEKI_MIN_RECORD - 1;
+    p = memchr(p, '\0', end - p);
+    if (!p)
+      break;
+    p++;
+    count++;
+  }
+  if (p != end) {
+    free(names);
+    return 0;
+  }
+
+  /* One extra pattern with a NULL name marks the end of the list. */
+  database = malloc((count + 1) * sizeof(*database));
+  if (!database) {
+    free(names);
+    return 0;
+  }
+  memset(database, 0, (count + 1) * sizeof(*database));
+
+  p = (const unsigned char *) memchr(names, '\n', length) + 1;
+  for (n = 0; n < count; n++) {
+    for (k = 0; k < NUM_HASHBITS; k++) {
+      int bit = (p[k / 8] >> (7 - k % 8)) & 1;
+      database[n].fullboard_hash.hashval[k / bits_in_hashvalue]
+	|= (Hashvalue) bit << (bits_in_hashvalue - 1 - k % bits_in_hashvalue);
+    }
+    p += FUSEKI_HASH_BYTES;
+    database[n].number_of_stones = read_bin_int(p);
+    database[n].move_offset = read_bin_int(p + 4);
+    database[n].value = read_bin_int(p + 8);
+    p += 12;
+    database[n].name = (const char *) p;
+    p += strlen((const char *) p) + 1;
+  }
+  database[count].number_of_stones = -1;
+  database[count].name = NULL;
+
+  fullboard_index_clear(&fuseki_index[size]);
+  free(loaded_fuseki[size]);
+  free(loaded_fuseki_names[size]);
+  loaded_fuseki[size] = database;
+  loaded_fuseki_names[size] = names;
+
+  return size;
+}
+
+
 /* Full board matching in database for fuseki moves. Return 1 if any
  * pattern found.
  */
@@ -293,20 +452,21 @@ search_fuseki_database(int color)
   if (stones_on_board(BLACK | WHITE) > MAX_FUSEKI_DATABASE_STONES)
     return 0;
 
-  /* We only have databases for 9x9, 13x13 and 19x19. */
-  if (board_size == 9)
-    database = fuseki9;
-  else if (board_size == 13)
-    database = fuseki13;
-  else if (board_size == 19)
-    database = fuseki19;
-  else
+  database = get_fuseki_database(board_size);
+  if (!database)
     return 0;
 
+  /* If there is no memory for the hash table, fullboard_matchpat()
+   * tries all patterns instead.
+   */
+  if (!fuseki_index[board_size].patterns)
+    fullboard_index_init(&fuseki_index[board_size], database);
+
   /* Do the matching. */
   num_fuseki_moves = 0;
   fuseki_total_value = 0;
-  fullboard_matchpat(fuseki_callback, color, database);
+  fullboard_matchpat(fuseki_callback, color, database,
+		     &fuseki_index[board_size]);
 
   /* No match. */
   if (num_fuseki_moves == 0)
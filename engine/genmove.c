@@ -82,8 +82,11 @@ reset_engine()
    */
   reuse_random_seed();
 
-  /* Initialize things for hashing of positions. */
-  reading_cache_clear();
+  /* Initialize things for hashing of positions. Results stored with
+   * the same settings stay valid if the cache is reused, since the
+   * hash identifies the position.
+   */
+  reading_cache_new_move();
 
   hashdata_recalc(&board_hash, board, board_ko_pos);
 
@@ -100,6 +103,7 @@ reset_engine()
 
   /* Set up depth values (see comments there for details). */
   set_depth_values(get_level(), 0);
+  reading_cache_set_depth_values();
 
   /* Initialize arrays of moves which are meaningless due to
    * static analysis of unconditional status.
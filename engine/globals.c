@@ -110,6 +110,14 @@ int experimental_connections = EXPERIMENTAL_CONNECTIONS;
 int alternate_connections = ALTERNATE_CONNECTIONS;
 /* compute owl threats */
 int owl_threats = OWL_THREATS; 
+/* number of processes sharing the owl reading of the dragons */
+int owl_jobs = 1;
+/* number of processes sharing the tactical reading of the worms */
+int worm_jobs = 1;
+/* share the read result cache with those processes */
+int shared_reading_cache = 0;
+/* keep the read result cache between moves */
+int reuse_reading_cache = 0;
 /* use experimental owl extension (GAIN/LOSS) */
 int experimental_owl_ext = EXPERIMENTAL_OWL_EXT;
 /* use experimental territory break-in module */
@@ -135,6 +143,8 @@ int mc_games_per_level = 8000;  /* By default, use 8000 times the current
 				 * for each mmove when Monte Carlo
 				 * move generation is enabled.
 				 */
+int mc_threads = 1;             /* Threads sharing the Monte Carlo search. */
+int mc_reuse_tree = 0;          /* Keep the Monte Carlo tree between moves. */
 
 float best_move_values[10];
 int   best_moves[10];
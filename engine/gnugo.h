@@ -49,6 +49,7 @@
 /* interface.c */
 /* Initialize the whole thing. Should be called once. */
 void init_gnugo(float memory, unsigned int random_seed);
+void init_gnugo_tables(void);
 
 
 /* ================================================================ */
@@ -110,6 +111,25 @@ int gameinfo_play_sgftree_rot(Gameinfo *gameinfo, SGFTree *tree,
 			      const char *untilstr, int orientation);
 int gameinfo_play_sgftree(Gameinfo *gameinfo, SGFTree *tree,
 			  const char *untilstr);
+int gameinfo_sync_sgftree(Gameinfo *gameinfo, SGFTree *tree);
+
+
+/* Everything the engine keeps about one game, as opposed to the
+ * pattern tables and caches shared by all games. Used to alternate
+ * between several games in one process.
+ */
+typedef struct {
+  struct board_state position;	/* board, move history, komi, handicap */
+  char *synced_setup;		/* state of gameinfo_sync_sgftree() */
+  int synced_setup_length;
+  int synced_board_size;
+  Hash_data synced_start_hash;
+} Gamecontext;
+
+void gamecontext_init(Gamecontext *context);
+void gamecontext_save(Gamecontext *context);
+void gamecontext_restore(Gamecontext *context);
+void gamecontext_free(Gamecontext *context);
 
 
 /* ================================================================ */
@@ -213,6 +233,10 @@ extern int experimental_owl_ext;     /* use experimental owl (GAIN/LOSS) */
 extern int experimental_connections; /* use experimental connection module */
 extern int alternate_connections;    /* use alternate connection module */
 extern int owl_threats;              /* compute owl threats */
+extern int owl_jobs;                 /* processes for owl reading of dragons */
+extern int worm_jobs;                /* processes for reading of worms */
+extern int shared_reading_cache;     /* share read results with them */
+extern int reuse_reading_cache;      /* keep read results between moves */
 extern int capture_all_dead;         /* capture all dead opponent stones */
 extern int play_out_aftermath; /* make everything unconditionally settled */
 extern int resign_allowed;           /* allows GG to resign hopeless games */
@@ -221,6 +245,8 @@ extern int mirror_stones_limit;      /* but stop at this number of stones */
 extern int gtp_version;              /* version of Go Text Protocol */
 extern int use_monte_carlo_genmove;  /* use Monte Carlo move generation */
 extern int mc_games_per_level;       /* number of Monte Carlo simulations per level */
+extern int mc_threads;               /* threads sharing the Monte Carlo search */
+extern int mc_reuse_tree;            /* keep the Monte Carlo tree between moves */
 
 /* Mandatory values of reading parameters. Normally -1, if set
  * these override the values derived from the level. */
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "liberty.h"
 #include "influence.h"
@@ -176,6 +177,173 @@ static int influence_id = 0;
 #endif
 
 
+/* With compilers supporting vector types the contributions in the
+ * four orthogonal and the four diagonal directions are computed and
+ * compared with the cutoff four at a time. This becomes SSE code on
+ * x86 and SIMD128 code in WebAssembly when compiled with -msimd128,
+ * and plain scalar code elsewhere.
+ *
+ * Spreading a whole row of the board at once does not fit the
+ * algorithm since the influence at a point is only known when all
+ * points closer to the source have been spread from and the cutoff
+ * decides which points are reached at all. What is vectorized is the
+ * work at each point taken from the queue. The direction dependent
+ * damping, (a*a) * b in the code above, only depends on the offset
+ * from the source and is looked up in a table, with zero for the
+ * directions which are not outwards. The arithmetic is done in the
+ * same order and precision as in the scalar code, so the results are
+ * identical to those of the other versions.
+ */
+
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#define VECTORIZED_INFLUENCE 1
+#else
+#define VECTORIZED_INFLUENCE 0
+#endif
+
+#if VECTORIZED_INFLUENCE
+typedef float influence_vector __attribute__ ((vector_size (16)));
+typedef int influence_mask __attribute__ ((vector_size (16)));
+
+#define MAX_SPREAD_DELTA (MAX_BOARD - 1)
+#define SPREAD_DELTAS (2 * MAX_SPREAD_DELTA + 1)
+
+/* Direction dependent damping for the orthogonal and the diagonal
+ * directions, in the order of delta[], indexed by the offset from the
+ * source.
+ */
+struct spread_damping {
+  influence_vector orthogonal;
+  influence_vector diagonal;
+};
+
+static struct spread_damping spread_damping[SPREAD_DELTAS][SPREAD_DELTAS];
+static influence_vector spread_cutoff;
+static int spread_damping_initialized = 0;
+
+static void
+init_spread_damping(void)
+{
+  int delta_i;
+  int delta_j;
+  int d;
+
+  /* The largest float not above INFLUENCE_CUTOFF. */
+  float cutoff = INFLUENCE_CUTOFF;
+  if (cutoff > INFLUENCE_CUTOFF)
+    cutoff = nextafterf(cutoff, 0.0);
+  for (d = 0; d < 4; d++)
+    spread_cutoff[d] = cutoff;
+
+  for (delta_i = -MAX_SPREAD_DELTA; delta_i <= MAX_SPREAD_DELTA; delta_i++)
+    for (delta_j = -MAX_SPREAD_DELTA; delta_j <= MAX_SPREAD_DELTA; delta_j++) {
+      struct spread_damping *s = &spread_damping[delta_i + MAX_SPREAD_DELTA]
+						[delta_j + MAX_SPREAD_DELTA];
+      float b;
+
+      /* All directions are outwards from the source itself. */
+      if (delta_i == 0 && delta_j == 0) {
+	for (d = 0; d < 4; d++) {
+	  s->orthogonal[d] = 1.0;
+	  s->diagonal[d] = 1.0;
+	}
+	continue;
+      }
+
+      b = 1.0 / ((delta_i)*(delta_i) + (delta_j)*(delta_j));
+      for (d = 0; d < 4; d++) {
+	int a = deltai[d]*(delta_i) + deltaj[d]*(delta_j);
+	if (a > 0)
+	  s->orthogonal[d] = (a*a) * b;
+	else
+	  s->orthogonal[d] = 0.0;
+      }
+
+      b *= 0.5;
+      for (d = 0; d < 4; d++) {
+	int a = deltai[d + 4]*(delta_i) + deltaj[d + 4]*(delta_j);
+	if (a > 0)
+	  s->diagonal[d] = (a*a) * b;
+	else
+	  s->diagonal[d] = 0.0;
+      }
+    }
+
+  spread_damping_initialized = 1;
+}
+
+
+/* Spread influence from ii to its neighbors like the loops in
+ * accumulate_influence() below. Returns the new end of the queue.
+ */
+static int
+spread_influence_vectorized(struct influence_data *q, float *working,
+			    const float *permeability_array, int ii,
+			    int delta_i, int delta_j, float current_strength,
+			    float inv_diagonal_damping, int queue_end)
+{
+  const struct spread_damping *s
+    = &spread_damping[delta_i + MAX_SPREAD_DELTA][delta_j + MAX_SPREAD_DELTA];
+  float permeability = permeability_array[ii];
+  float passed[4];
+  influence_vector diagonal_permeability;
+  influence_vector contributions[2];
+  influence_mask above_cutoff[2];
+  int directions;
+  int k;
+
+  /* The permeability of the vertices passed by in diagonal movement.
+   * They are off the board only when the diagonal neighbor is.
+   */
+  for (k = 0; k < 4; k++) {
+    if (ON_BOARD(ii + delta[k]))
+      passed[k] = permeability_array[ii + delta[k]];
+    else
+      passed[k] = 0.0;
+  }
+  diagonal_permeability[0] = gg_max(passed[0], passed[1]);
+  diagonal_permeability[1] = gg_max(passed[2], passed[1]);
+  diagonal_permeability[2] = gg_max(passed[2], passed[3]);
+  diagonal_permeability[3] = gg_max(passed[0], passed[3]);
+
+  contributions[0] = (current_strength * permeability) * s->orthogonal;
+  contributions[1] = (((current_strength * inv_diagonal_damping)
+		       * (permeability * diagonal_permeability))
+		      * s->diagonal);
+
+  /* Stop spreading influence if the contribution becomes too low.
+   * This is also the case for directions which are not outwards. The
+   * cutoff is rounded down to single precision, so the test is the
+   * same as in double precision.
+   */
+  above_cutoff[0] = contributions[0] > spread_cutoff;
+  above_cutoff[1] = contributions[1] > spread_cutoff;
+  directions = ((above_cutoff[0][0] & 1) | (above_cutoff[0][1] & 2)
+		| (above_cutoff[0][2] & 4) | (above_cutoff[0][3] & 8)
+		| (above_cutoff[1][0] & 16) | (above_cutoff[1][1] & 32)
+		| (above_cutoff[1][2] & 64) | (above_cutoff[1][3] & 128));
+
+  /* Spread in the remaining directions in the order of delta[]. */
+  while (directions) {
+    int pos;
+    k = __builtin_ctz(directions);
+    directions &= directions - 1;
+    pos = ii + delta[k];
+    if (!ON_BOARD(pos) || q->safe[pos])
+      continue;
+
+    if (working[pos] == 0.0) {
+      q->queue[queue_end] = pos;
+      queue_end++;
+    }
+    working[pos] += contributions[k / 4][k % 4];
+  }
+
+  return queue_end;
+}
+#endif
+
+
 static void
 accumulate_influence(struct influence_data *q, int pos, int color)
 {
@@ -183,10 +351,12 @@ accumulate_influence(struct influence_data *q, int pos, int color)
   int m = I(pos);
   int n = J(pos);
   int k;
-#if !EXPLICIT_LOOP_UNROLLING
+#if !VECTORIZED_INFLUENCE && !EXPLICIT_LOOP_UNROLLING
   int d;
 #endif
+#if !VECTORIZED_INFLUENCE
   float b;
+#endif
   float inv_attenuation;
   float inv_diagonal_damping;
   float *permeability_array;
@@ -204,6 +374,11 @@ accumulate_influence(struct influence_data *q, int pos, int color)
     working_area_initialized = 1;
   }
 
+#if VECTORIZED_INFLUENCE
+  if (!spread_damping_initialized)
+    init_spread_damping();
+#endif
+
   if (0)
     gprintf("Accumulating influence for %s at %m\n",
 	    color_to_string(color), m, n);
@@ -247,13 +422,19 @@ accumulate_influence(struct influence_data *q, int pos, int color)
     if (0)
       gprintf("Picked %1m from queue. w=%f start=%d end=%d\n",
 	      ii, working[ii], queue_start, queue_end);
+    current_strength = working[ii] * inv_attenuation;
+
+#if VECTORIZED_INFLUENCE
+    queue_end = spread_influence_vectorized(q, working, permeability_array,
+					    ii, delta_i, delta_j,
+					    current_strength,
+					    inv_diagonal_damping, queue_end);
+#else
     if (queue_start == 1)
       b = 1.0;
     else
       b = 1.0 / ((delta_i)*(delta_i) + (delta_j)*(delta_j));
 
-    current_strength = working[ii] * inv_attenuation;
-
 #if !EXPLICIT_LOOP_UNROLLING
     /* Try to spread influence in each of the eight directions. */    
     for (d = 0; d < 8; d++) {
@@ -344,6 +525,7 @@ accumulate_influence(struct influence_data *q, int pos, int color)
       code1(deltai[6], deltaj[6], ii + delta[6], 1);
     if (ON_BOARD(ii + delta[7]))
       code1(deltai[7], deltaj[7], ii + delta[7], 1);
+#endif
 #endif
   }
   
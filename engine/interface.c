@@ -33,27 +33,50 @@
 #include "gg_utils.h"
 
 /*
- * Initialize the gnugo engine. This needs to be called 
- * once only.
+ * Set up the tables which depend neither on the game nor on the
+ * options: the Zobrist hash arrays, the pattern transformations, the
+ * dfa spiral order and the Monte Carlo patterns. The result is always
+ * the same, so this can be done ahead of time when taking a snapshot
+ * of an initialized wasm instance. Only the first call does any work.
  */
 
 void
-init_gnugo(float memory, unsigned int seed)
+init_gnugo_tables(void)
 {
+  static int is_initialized = 0;
+  if (is_initialized)
+    return;
+
   /* We need a fixed seed when initializing the Zobrist hashing to get
    * reproducable results.
    * FIXME: Test the quality of the seed.
    */
   set_random_seed(HASH_RANDOM_SEED);
-  reading_cache_init(memory * 1024 * 1024);
-  set_random_seed(seed);
-  persistent_cache_init();
-  clear_board();
+  hash_init();
+  keyhash_init();
 
   transformation_init();
   dfa_match_init();
   choose_mc_patterns(NULL);
 
+  is_initialized = 1;
+}
+
+
+/*
+ * Initialize the gnugo engine. This needs to be called 
+ * once only.
+ */
+
+void
+init_gnugo(float memory, unsigned int seed)
+{
+  init_gnugo_tables();
+  reading_cache_init(memory * 1024 * 1024);
+  set_random_seed(seed);
+  persistent_cache_init();
+  clear_board();
+
   clear_approxlib_cache();
   clear_accuratelib_cache();
 }
@@ -412,6 +435,238 @@ gameinfo_play_sgftree_rot(Gameinfo *gameinfo, SGFTree *tree,
   return next;
 }
 
+/* State of the last tree loaded by gameinfo_sync_sgftree(). The setup
+ * properties of the root node, the board size and the board hash
+ * before the first move identify the position the move history
+ * starts from.
+ */
+static char *synced_setup = NULL;
+static int synced_setup_length = 0;
+static int synced_board_size = -1;
+static Hash_data synced_start_hash;
+
+/* Collect the setup properties of the root node into a newly
+ * allocated buffer, so that two trees can be checked for a common
+ * starting position. The values are NUL separated, so the length is
+ * returned in *length.
+ */
+static char *
+sgf_setup_signature(SGFNode *root, int *length)
+{
+  SGFProperty *prop;
+  char *signature;
+  int size = 1;
+  int len = 0;
+
+  for (prop = root->props; prop; prop = prop->next)
+    size += strlen(prop->value) + 3;
+  signature = malloc(size);
+  if (signature == NULL) {
+    *length = 0;
+    return NULL;
+  }
+
+  for (prop = root->props; prop; prop = prop->next) {
+    switch (prop->name) {
+    case SGFSZ:
+    case SGFHA:
+    case SGFKM:
+    case SGFAB:
+    case SGFAW:
+    case SGFAE:
+    case SGFPL:
+    case SGFIL:
+      signature[len++] = prop->name & 0xff;
+      signature[len++] = prop->name >> 8;
+      strcpy(signature + len, prop->value);
+      len += strlen(prop->value) + 1;
+      break;
+    }
+  }
+
+  *length = len;
+  return signature;
+}
+
+/*
+ * Bring the board in line with the main variation of an SGF tree,
+ * reusing the current move history where possible. When the tree
+ * starts from the same setup as the previous tree passed to this
+ * function, only the moves after the common prefix with the move
+ * history are taken back by undo_move() and played. Each of them costs
+ * about one pass over the board, so the cost grows with the change
+ * rather than with the length of the game, except after
+ * gamecontext_restore() or when undo_move() has run out of undo
+ * information, where taking moves back means a replay of the game.
+ * Otherwise the tree is replayed from scratch by
+ * gameinfo_play_sgftree_rot().
+ *
+ * Returns the color of the next move to be made, EMPTY on failure.
+ */
+
+int
+gameinfo_sync_sgftree(Gameinfo *gameinfo, SGFTree *tree)
+{
+  static int moves[MAX_MOVE_HISTORY];
+  static int colors[MAX_MOVE_HISTORY];
+  int num_moves = 0;
+  int common = 0;
+  int incremental;
+  int next;
+  int k;
+  int setup_length;
+  char *setup = sgf_setup_signature(tree->root, &setup_length);
+  SGFNode *node;
+  SGFNode *lastnode = NULL;
+
+  /* The incremental path requires an unbroken move history from the
+   * same starting position.
+   */
+  incremental = (setup != NULL && synced_setup != NULL
+		 && setup_length == synced_setup_length
+		 && memcmp(setup, synced_setup, setup_length) == 0
+		 && board_size == synced_board_size
+		 && stackp == 0
+		 && move_history_pointer > 0
+		 && move_history_pointer == movenum
+		 && hashdata_is_equal(move_history_hash[0], synced_start_hash));
+
+  /* Collect the moves of the main variation. Setup properties after
+   * the root node can't be matched against the move history.
+   */
+  for (node = tree->root; incremental && node; node = node->child) {
+    SGFProperty *prop;
+    for (prop = node->props; prop; prop = prop->next) {
+      if (prop->name == SGFB || prop->name == SGFW) {
+	if (num_moves == MAX_MOVE_HISTORY) {
+	  incremental = 0;
+	  break;
+	}
+	moves[num_moves] = get_sgfmove(prop);
+	colors[num_moves] = (prop->name == SGFW) ? WHITE : BLACK;
+	num_moves++;
+      }
+      else if (node != tree->root
+	       && (prop->name == SGFAB || prop->name == SGFAW
+		   || prop->name == SGFAE || prop->name == SGFPL
+		   || prop->name == SGFIL)) {
+	incremental = 0;
+	break;
+      }
+    }
+    lastnode = node;
+  }
+
+  if (incremental && num_moves > 0) {
+    while (common < num_moves && common < move_history_pointer
+	   && moves[common] == move_history_pos[common]
+	   && colors[common] == move_history_color[common])
+      common++;
+
+    if (common == 0
+	|| (common < move_history_pointer
+	    && !undo_move(move_history_pointer - common)))
+      incremental = 0;
+
+    for (k = common; incremental && k < num_moves; k++) {
+      if (moves[k] != PASS_MOVE && board[moves[k]] != EMPTY)
+	incremental = 0;
+      else
+	gnugo_play_move(moves[k], colors[k]);
+    }
+  }
+  else
+    incremental = 0;
+
+  if (incremental) {
+    DEBUG(DEBUG_LOADSGF, "Kept %d moves, replayed %d\n",
+	  common, num_moves - common);
+    next = OTHER_COLOR(colors[num_moves - 1]);
+    gameinfo->handicap = handicap;
+    gameinfo->to_move = next;
+    tree->lastnode = lastnode;
+    free(setup);
+    return next;
+  }
+
+  next = gameinfo_play_sgftree_rot(gameinfo, tree, NULL, 0);
+
+  free(synced_setup);
+  synced_setup = NULL;
+  if (next != EMPTY && move_history_pointer > 0) {
+    synced_setup = setup;
+    synced_setup_length = setup_length;
+    synced_board_size = board_size;
+    synced_start_hash = move_history_hash[0];
+  }
+  else
+    free(setup);
+
+  return next;
+}
+
+
+/* Game contexts.
+ *
+ * The engine works on one game at a time, kept in global variables.
+ * gamecontext_save() moves the state belonging to the current game,
+ * i.e. the board with its move history and the state of
+ * gameinfo_sync_sgftree(), into a context and gamecontext_restore()
+ * makes the game in a context the current one. The pattern tables,
+ * the transposition table and the persistent caches are shared by all
+ * games; their entries are keyed by the position, so they stay valid
+ * when switching.
+ */
+
+/* Initialize a context to an empty board of the current size. */
+void
+gamecontext_init(Gamecontext *context)
+{
+  memset(context, 0, sizeof(*context));
+  context->synced_board_size = -1;
+}
+
+/* Save the current game into context. */
+void
+gamecontext_save(Gamecontext *context)
+{
+  store_board(&context->position);
+
+  /* The context takes over the sync state. */
+  free(context->synced_setup);
+  context->synced_setup = synced_setup;
+  context->synced_setup_length = synced_setup_length;
+  context->synced_board_size = synced_board_size;
+  context->synced_start_hash = synced_start_hash;
+  synced_setup = NULL;
+}
+
+/* Make the game saved in context the current one. */
+void
+gamecontext_restore(Gamecontext *context)
+{
+  if (context->position.board_size > 0)
+    restore_board(&context->position);
+  else
+    clear_board();
+
+  free(synced_setup);
+  synced_setup = context->synced_setup;
+  synced_setup_length = context->synced_setup_length;
+  synced_board_size = context->synced_board_size;
+  synced_start_hash = context->synced_start_hash;
+  context->synced_setup = NULL;
+}
+
+/* Release the memory held by a context. */
+void
+gamecontext_free(Gamecontext *context)
+{
+  free(context->synced_setup);
+  context->synced_setup = NULL;
+}
+
+
 /* Same as previous function, using standard orientation */
 
 int
@@ -164,6 +164,7 @@ const char *status_to_string(enum dragon_status status);
 struct pattern;
 struct pattern_db;
 struct fullboard_pattern;
+struct fullboard_index;
 struct corner_pattern;
 struct corner_db;
 struct half_eye_data;
@@ -190,13 +191,21 @@ void matchpat_goal_anchor(matchpat_callback_fn_ptr callback, int color,
 	      struct pattern_db *pdb, void *callback_data,
 	      signed char goal[BOARDMAX], int anchor_in_goal);
 void fullboard_matchpat(fullboard_matchpat_callback_fn_ptr callback,
-			int color, struct fullboard_pattern *pattern);
+			int color, struct fullboard_pattern *pattern,
+			const struct fullboard_index *index);
+int fullboard_index_init(struct fullboard_index *index,
+			 struct fullboard_pattern *pattern);
+void fullboard_index_clear(struct fullboard_index *index);
 void corner_matchpat(corner_matchpat_callback_fn_ptr callback, int color,
 		     struct corner_db *database);
 void dfa_match_init(void);
 
 void reading_cache_init(int bytes);
+void keyhash_init(void);
 void reading_cache_clear(void);
+void reading_cache_new_move(void);
+void reading_cache_set_depth_values(void);
+int reading_cache_share(void);
 float reading_cache_default_size(void);
 
 /* reading.c */
@@ -224,6 +233,9 @@ void draw_reading_shadow(void);
 void persistent_cache_init(void);
 void purge_persistent_caches(void);
 void clear_persistent_caches(void);
+int export_persistent_caches(char *data, int length);
+int import_persistent_caches(const char *data, int length);
+int merge_persistent_caches(const char *data, int length);
 
 int search_persistent_reading_cache(enum routine_id routine, int str,
 				    int *result, int *move);
@@ -292,6 +304,10 @@ int dragon_weak(int pos);
 float dragon_weakness(int pos, int ignore_dead_dragons);
 int size_of_biggest_critical_dragon(void);
 void change_dragon_status(int dr, enum dragon_status status);
+void analyze_in_processes(int jobs, const int *origins, int num_origins,
+			  void (*analyze)(int pos), int result_size,
+			  void (*export_result)(int pos, void *result),
+			  void (*import_result)(int pos, const void *result));
 float blunder_size(int move, int color, int *defense_point,
 		   signed char safe_stones[BOARDMAX]);
 void set_depth_values(int level, int report_levels);
@@ -470,6 +486,8 @@ int free_handicap_total_stones(void);
 
 /* Various different strategies for finding a move */
 void fuseki(int color);
+int load_fuseki_database(const char *data, int length);
+int need_fuseki_database(int size);
 void semeai(void);
 void semeai_move_reasons(int color);
 void shapes(int color);
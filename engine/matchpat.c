@@ -519,22 +519,13 @@ matchpat_loop(matchpat_callback_fn_ptr callback, int color, int anchor,
 /* #define DFA_TRACE 1 */
 
 /* Data. */
-static int dfa_board_size = -1;
-static int dfa_p[DFA_BASE * DFA_BASE];
-
-/* This is used by the EXPECTED_COLOR macro. */
-static const int convert[3][4] = {
-  {-1, -1, -1, -1},		/* not used */
-  {EMPTY, WHITE, BLACK, OUT_BOARD},	/* WHITE */
-  {EMPTY, BLACK, WHITE, OUT_BOARD}	/* BLACK */
-};
-#define EXPECTED_COLOR(player_c, position_c)  		\
-		(convert[player_c][position_c])
+/* The dfa board for the color we are matching for, see dfa.h. */
+static const unsigned char *dfa_p = dfa_board[0];
 
 /* Forward declarations. */
 static void dfa_prepare_for_match(int color);
-static int scan_for_patterns(dfa_rt_t *pdfa, int l, int *dfa_pos,
-			     int *pat_list);
+static int scan_for_patterns(dfa_rt_t *pdfa, int l,
+			     const unsigned char *dfa_pos, int *pat_list);
 static void do_dfa_matchpat(dfa_rt_t *pdfa,
 			    int anchor, matchpat_callback_fn_ptr callback,
 			    int color, struct pattern *database,
@@ -584,33 +575,16 @@ dfa_match_init(void)
     DEBUG(DEBUG_MATCHER, "barrierspat --> using dfa\n");
   if (fusekipat_db.pdfa != NULL)
     DEBUG(DEBUG_MATCHER, "barrierspat --> using dfa\n");
-
-  /* force out_board initialization */
-  dfa_board_size = -1;
 }
 
 /* 
- * copy the board on a private board with adapted colors 
- * and adapted size 
+ * Select the dfa board with the colors adapted to the player. It is
+ * kept up to date by board.c, so there is nothing to copy here.
  */
 static void
 dfa_prepare_for_match(int color)
 {
-  int i, j;
-  int pos;
-    
-  if (dfa_board_size != board_size) {
-    dfa_board_size = board_size;
-    /* clean up the board */
-    for (pos = 0; pos < DFA_BASE * DFA_BASE; pos++)
-      dfa_p[pos] = OUT_BOARD;
-  }
-
-  /* copy the board */
-  for (i = 0; i < dfa_board_size; i++)
-    for (j = 0; j < dfa_board_size; j++)
-      dfa_p[DFA_POS(i, j)] = EXPECTED_COLOR(color, BOARD(i, j));
-
+  dfa_p = dfa_board[color == WHITE ? 0 : 1];
   prepare_for_match(color);
 }
 
@@ -621,8 +595,8 @@ dump_dfa_board(int m, int n)
 {
   int i, j;
 
-  for (i = 0; i < dfa_board_size; i++) {
-    for (j = 0; j < dfa_board_size; j++) {
+  for (i = 0; i < board_size; i++) {
+    for (j = 0; j < board_size; j++) {
       if (i != m || j != n)
 	fprintf(stderr, "%1d", dfa_p[DFA_POS(i, j)]);
       else
@@ -641,7 +615,8 @@ dump_dfa_board(int m, int n)
  * `pat_list'.  Return the number of patterns found.
  */
 static int
-scan_for_patterns(dfa_rt_t *pdfa, int l, int *dfa_pos, int *pat_list)
+scan_for_patterns(dfa_rt_t *pdfa, int l, const unsigned char *dfa_pos,
+		  int *pat_list)
 {
   int delta;
   int state = 1; /* initial state */
@@ -679,7 +654,7 @@ do_dfa_matchpat(dfa_rt_t *pdfa,
   int ll;      /* Iterate over transformations (rotations or reflections)  */
   int patterns[DFA_MAX_MATCHED + 8];
   int num_matched = 0;
-  int *dfa_pos = dfa_p + DFA_POS(I(anchor), J(anchor));
+  const unsigned char *dfa_pos = dfa_p + DFA_POS(I(anchor), J(anchor));
 
   /* Basic sanity checks. */
   ASSERT_ON_BOARD1(anchor);
@@ -907,64 +882,171 @@ fullboard_transform(int pos, int trans)
   return POS(x + (board_size-1)/2, y + (board_size-1)/2);
 }
 
+/* The inverse of each transformation in transformation2[][]. */
+static const int inverse_transformation[8] = {0, 3, 2, 1, 4, 5, 6, 7};
+
+/* Build a hash table over the fullboard patterns, ending with a
+ * pattern with NULL name. Return 1 if successful and 0 if out of
+ * memory, in which case the index is left empty.
+ */
+int
+fullboard_index_init(struct fullboard_index *index,
+		     struct fullboard_pattern *pattern)
+{
+  int num_patterns;
+  int *last;
+  int k;
+
+  for (num_patterns = 0; pattern[num_patterns].name; num_patterns++)
+    ;
+
+  /* Keep the table at most half full. */
+  index->patterns = pattern;
+  index->num_slots = 2 * num_patterns + 1;
+  index->slots = malloc(index->num_slots * sizeof(*index->slots));
+  index->next = malloc((num_patterns + 1) * sizeof(*index->next));
+  last = malloc(index->num_slots * sizeof(*last));
+  if (!index->slots || !index->next || !last) {
+    free(last);
+    fullboard_index_clear(index);
+    return 0;
+  }
+
+  for (k = 0; k < index->num_slots; k++)
+    index->slots[k] = -1;
+
+  /* Link the patterns with the same hash value in database order. */
+  for (k = 0; k < num_patterns; k++) {
+    int slot = hashdata_remainder(pattern[k].fullboard_hash,
+				  index->num_slots);
+    while (index->slots[slot] != -1
+	   && !hashdata_is_equal(pattern[index->slots[slot]].fullboard_hash,
+				 pattern[k].fullboard_hash))
+      slot = (slot + 1) % index->num_slots;
+
+    if (index->slots[slot] == -1)
+      index->slots[slot] = k;
+    else
+      index->next[last[slot]] = k;
+    last[slot] = k;
+    index->next[k] = -1;
+  }
+
+  free(last);
+  return 1;
+}
+
+
+/* Free the hash table built by fullboard_index_init(). */
+void
+fullboard_index_clear(struct fullboard_index *index)
+{
+  free(index->slots);
+  free(index->next);
+  memset(index, 0, sizeof(*index));
+}
+
+
+static int
+compare_fullboard_matches(const void *a, const void *b)
+{
+  return *(const int *) a - *(const int *) b;
+}
+
+
 /* A dedicated matcher which can only do fullboard matching on
- * odd-sized boards, optimized for fuseki patterns.
+ * odd-sized boards, optimized for fuseki patterns. If index is not
+ * NULL it must be built from the same patterns and each orientation
+ * of the board is looked up in it. Otherwise all patterns are tried.
+ * Either way the callbacks are made in database order.
  */
 void
 fullboard_matchpat(fullboard_matchpat_callback_fn_ptr callback, int color,
-		   struct fullboard_pattern *pattern)
+		   struct fullboard_pattern *pattern,
+		   const struct fullboard_index *index)
 {
   int ll;   /* Iterate over transformations (rotations or reflections)  */
+  int pos;
   /* We transform around the center point. */
   int number_of_stones_on_board = stones_on_board(BLACK | WHITE);
-  static int color_map[gg_max(WHITE, BLACK) + 1];
   /* One hash value for each rotation/reflection: */
   Hash_data current_board_hash[8];
+  /* Matched patterns times 8 plus the transformation. */
+  int matches[8 * MAX_BOARD * MAX_BOARD];
+  int num_matches = 0;
+  int k;
   
   /* Basic sanity check. */
   gg_assert(color != EMPTY);
   gg_assert(board_size % 2 == 1);
 
-  color_map[EMPTY] = EMPTY;
-  if (color == WHITE) {
-    color_map[WHITE] = WHITE;
-    color_map[BLACK] = BLACK;
-  }
-  else {
-    color_map[WHITE] = BLACK;
-    color_map[BLACK] = WHITE;
+  /* Get hash data of all rotations/reflections of current board
+   * position, with the colors swapped when matching for black. A
+   * stone at pos ends up at the inverse transformation of pos.
+   */
+  for (ll = 0; ll < 8; ll++) {
+    hashdata_clear(&current_board_hash[ll]);
+    if (ON_BOARD(board_ko_pos))
+      hashdata_invert_ko(&current_board_hash[ll],
+			 fullboard_transform(board_ko_pos, ll));
   }
 
-  /* Get hash data of all rotations/reflections of current board position. */
-  for (ll = 0; ll < 8; ll++) {
-    Intersection p[BOARDSIZE];
-    int pos;
-    for (pos = 0; pos < BOARDSIZE; pos++)
-      if (ON_BOARD(pos))
-	p[pos] = color_map[board[fullboard_transform(pos, ll)]];
-      else
-	p[pos] = GRAY;
+  for (pos = BOARDMIN; pos < BOARDMAX; pos++)
+    if (IS_STONE(board[pos])) {
+      int stone = board[pos];
+      if (color == BLACK)
+	stone = OTHER_COLOR(stone);
+      for (ll = 0; ll < 8; ll++)
+	hashdata_invert_stone(&current_board_hash[ll],
+			      fullboard_transform(pos,
+						  inverse_transformation[ll]),
+			      stone);
+    }
 
-    if (ON_BOARD(board_ko_pos))
-      hashdata_recalc(&current_board_hash[ll], p,
-		      fullboard_transform(board_ko_pos, ll));
-    else 
-      hashdata_recalc(&current_board_hash[ll], p, NO_MOVE);
+  if (!index || !index->slots) {
+    /* Try each pattern - NULL pattern name marks end of list. */
+    for (; pattern->name; pattern++) { 
+      if (pattern->number_of_stones != number_of_stones_on_board)
+	continue;
+      /* Try each orientation transformation. */
+      for (ll = 0; ll < 8; ll++)
+	if (hashdata_is_equal(current_board_hash[ll],
+			      pattern->fullboard_hash)) {
+	  /* A match!  - Call back to the invoker to let it know. */
+	  pos = AFFINE_TRANSFORM(pattern->move_offset, ll,
+				 POS((board_size-1)/2, (board_size-1)/2));
+	  callback(pos, pattern, ll);
+	}
+    }
+    return;
   }
 
-  /* Try each pattern - NULL pattern name marks end of list. */
-  for (; pattern->name; pattern++) { 
-    if (pattern->number_of_stones != number_of_stones_on_board)
-      continue;
-    /* Try each orientation transformation. */
-    for (ll = 0; ll < 8; ll++)
-      if (hashdata_is_equal(current_board_hash[ll], pattern->fullboard_hash)) {
-	/* A match!  - Call back to the invoker to let it know. */
-	int pos = AFFINE_TRANSFORM(pattern->move_offset, ll,
-			           POS((board_size-1)/2, (board_size-1)/2));
-	callback(pos, pattern, ll);
+  /* Look up each orientation and make the callbacks in the same order
+   * as above.
+   */
+  gg_assert(index->patterns == pattern);
+  for (ll = 0; ll < 8; ll++) {
+    int slot = hashdata_remainder(current_board_hash[ll], index->num_slots);
+    while (index->slots[slot] != -1
+	   && !hashdata_is_equal(pattern[index->slots[slot]].fullboard_hash,
+				 current_board_hash[ll]))
+      slot = (slot + 1) % index->num_slots;
+
+    for (k = index->slots[slot]; k != -1; k = index->next[k])
+      if (pattern[k].number_of_stones == number_of_stones_on_board) {
+	gg_assert(num_matches < (int) (sizeof(matches) / sizeof(matches[0])));
+	matches[num_matches++] = 8 * k + ll;
       }
   }
+  gg_sort(matches, num_matches, sizeof(matches[0]), compare_fullboard_matches);
+
+  for (k = 0; k < num_matches; k++) {
+    struct fullboard_pattern *match = &pattern[matches[k] / 8];
+    ll = matches[k] % 8;
+    pos = AFFINE_TRANSFORM(match->move_offset, ll,
+			   POS((board_size-1)/2, (board_size-1)/2));
+    callback(pos, match, ll);
+  }
 }
 
 
@@ -34,6 +34,10 @@
 #include "random.h"
 #include <math.h>
 
+#if HAVE_PTHREAD_CREATE
+#include <pthread.h>
+#endif
+
 /* FIXME: Replace with a DEBUG_MC symbol for use with -d. */
 static int mc_debug = 0;
 
@@ -1526,8 +1530,19 @@ struct mc_game {
   int consecutive_passes;
   int consecutive_ko_captures;
   int depth;
+  /* Random number generator state, NULL for the global generator. */
+  struct gg_rand_state *random_state;
 };
 
+/* Random number in [0.0, 1.0) from the generator of the game. */
+static double
+mc_drand(struct mc_game *game)
+{
+  if (game->random_state)
+    return gg_drand_r(game->random_state);
+  return gg_drand();
+}
+
 
 /* Generate a random move. */
 static int
@@ -1633,7 +1648,7 @@ mc_generate_random_move(struct mc_game *game)
     move = PASS_MOVE;
   else {
     /* First choose a partition. */
-    x = (int) (gg_drand() * *move_value_sum);
+    x = (int) (mc_drand(game) * *move_value_sum);
     for (k = 0; k < NUM_MOVE_PARTITIONS; k++) {
       x -= partition_sums[k];
       if (x < 0)
@@ -1641,7 +1656,7 @@ mc_generate_random_move(struct mc_game *game)
     }
 
     /* Then choose a move in that partition. */
-    x = (unsigned int) (gg_drand() * partition_sums[k]);
+    x = (unsigned int) (mc_drand(game) * partition_sums[k]);
     for (pos = partition_lists[k]; pos != 1; pos = partition_lists[pos]) {
       x -= move_values[pos];
       if (x < 0)
@@ -1750,6 +1765,18 @@ static int mc_play_random_game(struct mc_game *game)
 
 #define UCT_MAX_SEARCH_DEPTH BOARDMAX
 
+/* Several threads can search the same tree if there are threads and
+ * the compiler has the __sync builtins for atomic operations.
+ */
+#if HAVE_PTHREAD_CREATE && defined(__GNUC__)
+#define UCT_THREADS 1
+#else
+#define UCT_THREADS 0
+#endif
+
+/* Upper limit for mc_threads. */
+#define UCT_MAX_THREADS 64
+
 struct bitboard {
   /* FIXME: Do this properly. */
   unsigned int bits[1 + BOARDMAX / 32];
@@ -1761,6 +1788,10 @@ struct uct_arc {
   struct uct_arc *next;
 };
 
+/* The wins and games counters, the untested bits and the child list
+ * are updated atomically while threads share the tree. The score
+ * sums are only used for debug output and are not.
+ */
 struct uct_node {
   int wins;
   int games;
@@ -1771,6 +1802,11 @@ struct uct_node {
   Hash_data boardhash;
 };
 
+/* The search tree, shared by all threads. Nodes and arcs are taken
+ * from the preallocated arrays by atomically increasing
+ * num_used_nodes and num_used_arcs, so nothing is ever freed during
+ * the search.
+ */
 struct uct_tree {
   struct uct_node *nodes;
   struct uct_arc *arcs;
@@ -1782,7 +1818,19 @@ struct uct_tree {
   int num_arcs;
   int num_used_arcs;
   int *forbidden_moves;
+  /* Count each game when a thread enters a node rather than when it
+   * returns. While the game is in progress it counts as a loss, which
+   * makes the other threads prefer different variations.
+   */
+  int virtual_loss;
+};
+
+/* What each thread searching the tree has for itself. */
+struct uct_search {
+  struct uct_tree *tree;
   struct mc_game game;
+  struct gg_rand_state *random_state;
+  struct gg_rand_state own_random_state;
   int move_score[BOARDSIZE];
   int move_ordering[BOARDSIZE];
   int inverse_move_ordering[BOARDSIZE];
@@ -1790,43 +1838,134 @@ struct uct_tree {
 };
 
 
-static struct uct_node *
-uct_init_node(struct uct_tree *tree, int *allowed_moves)
+/* Atomic operations on the shared tree. Without threads they are
+ * plain operations. The first two return the old value.
+ */
+static int
+uct_fetch_and_add(int *x, int n)
 {
-  int pos;
-  struct uct_node *node = &tree->nodes[tree->num_used_nodes++];
+#if UCT_THREADS
+  return __sync_fetch_and_add(x, n);
+#else
+  int old = *x;
+  *x += n;
+  return old;
+#endif
+}
 
-  node->wins = 0;
-  node->games = 0;
-  node->sum_scores = 0.0;
-  node->sum_scores2 = 0.0;
-  node->child = NULL;
+static unsigned int
+uct_fetch_and_and(unsigned int *x, unsigned int mask)
+{
+#if UCT_THREADS
+  return __sync_fetch_and_and(x, mask);
+#else
+  unsigned int old = *x;
+  *x &= mask;
+  return old;
+#endif
+}
+
+static int
+uct_set_hash_entry(unsigned int *entry, unsigned int node_index)
+{
+#if UCT_THREADS
+  return __sync_bool_compare_and_swap(entry, 0, node_index);
+#else
+  if (*entry != 0)
+    return 0;
+  *entry = node_index;
+  return 1;
+#endif
+}
+
+static int
+uct_set_first_child(struct uct_node *parent, struct uct_arc *arc)
+{
+#if UCT_THREADS
+  return __sync_bool_compare_and_swap(&parent->child, arc->next, arc);
+#else
+  if (parent->child != arc->next)
+    return 0;
+  parent->child = arc;
+  return 1;
+#endif
+}
+
+
+/* Mark the moves which may be tried from the current position. */
+static void
+uct_init_untested(struct uct_search *search, struct uct_node *node,
+		  int *allowed_moves)
+{
+  int pos;
   memset(node->untested.bits, 0, sizeof(node->untested.bits));
   for (pos = BOARDMIN; pos < BOARDMAX; pos++) {
-    if (tree->game.mc.board[pos] == EMPTY
-	&& !tree->forbidden_moves[pos]
+    if (search->game.mc.board[pos] == EMPTY
+	&& !search->tree->forbidden_moves[pos]
 	&& (!allowed_moves || allowed_moves[pos])) {
       node->untested.bits[pos / 32] |= 1 << pos % 32;
     }
   }
-  node->boardhash = tree->game.mc.hash;
+}
+
+/* Returns NULL if the tree is out of nodes. */
+static struct uct_node *
+uct_init_node(struct uct_search *search, int *allowed_moves)
+{
+  struct uct_tree *tree = search->tree;
+  int node_index = uct_fetch_and_add(&tree->num_used_nodes, 1);
+  struct uct_node *node;
+
+  if (node_index >= tree->num_nodes)
+    return NULL;
+
+  node = &tree->nodes[node_index];
+  node->wins = 0;
+  node->games = 0;
+  node->sum_scores = 0.0;
+  node->sum_scores2 = 0.0;
+  node->child = NULL;
+  uct_init_untested(search, node, allowed_moves);
+  node->boardhash = search->game.mc.hash;
 
   return node;
 }
 
+/* Find or create the node of the current position and add an arc to
+ * it from the parent. Returns NULL if the tree is out of nodes or
+ * arcs.
+ */
 static struct uct_node *
-uct_find_node(struct uct_tree *tree, struct uct_node *parent, int move)
+uct_find_node(struct uct_search *search, struct uct_node *parent, int move)
 {
+  struct uct_tree *tree = search->tree;
   struct uct_node *node = NULL;
-  Hash_data *boardhash = &tree->game.mc.hash;
+  struct uct_node *new_node = NULL;
+  Hash_data *boardhash = &search->game.mc.hash;
   unsigned int hash_index = hashdata_remainder(*boardhash,
 					       tree->hashtable_size);
   unsigned int *hashtable = tree->hashtable_even;
-  if (tree->game.depth & 1)
+  if (search->game.depth & 1)
     hashtable = tree->hashtable_odd;
 
-  while (hashtable[hash_index] != 0) {
+  while (1) {
     int node_index = hashtable[hash_index];
+    if (node_index == 0) {
+      /* Not found. Store a new node in the empty entry. If another
+       * thread fills the entry first, look again at what it stored.
+       */
+      if (!new_node) {
+	new_node = uct_init_node(search, NULL);
+	if (!new_node)
+	  return NULL;
+      }
+      if (uct_set_hash_entry(&hashtable[hash_index], new_node - tree->nodes)) {
+	node = new_node;
+	break;
+      }
+      continue;
+    }
+
     gg_assert(node_index > 0 && node_index < tree->num_nodes);
     if (hashdata_is_equal(tree->nodes[node_index].boardhash, *boardhash)) {
       node = &tree->nodes[node_index];
@@ -1836,24 +1975,19 @@ uct_find_node(struct uct_tree *tree, struct uct_node *parent, int move)
     if (hash_index >= tree->hashtable_size)
       hash_index = 0;
   }
-
-  if (!node) {
-    node = uct_init_node(tree, NULL);
-    gg_assert(hash_index < tree->hashtable_size);
-    hashtable[hash_index] = node - tree->nodes;
-  }
   
   /* Add the node as the first of the siblings. */
   if (parent) {
-    struct uct_arc *arc = &tree->arcs[tree->num_used_arcs++];
-    gg_assert(tree->num_used_arcs < tree->num_arcs);
+    int arc_index = uct_fetch_and_add(&tree->num_used_arcs, 1);
+    struct uct_arc *arc;
+    if (arc_index + 1 >= tree->num_arcs)
+      return NULL;
+    arc = &tree->arcs[arc_index];
     arc->move = move;
     arc->node = node;
-    if (parent->child)
+    do
       arc->next = parent->child;
-    else
-      arc->next = NULL;
-    parent->child = arc;
+    while (!uct_set_first_child(parent, arc));
   }
 
   return node;
@@ -1861,48 +1995,48 @@ uct_find_node(struct uct_tree *tree, struct uct_node *parent, int move)
 
 
 static void
-uct_update_move_ordering(struct uct_tree *tree, int move)
+uct_update_move_ordering(struct uct_search *search, int move)
 {
-  int score = ++tree->move_score[move];
+  int score = ++search->move_score[move];
   while (1) {
-    int n = tree->inverse_move_ordering[move];
+    int n = search->inverse_move_ordering[move];
     int preceding_move;
     if (n == 0)
       return;
-    preceding_move = tree->move_ordering[n - 1];
-    if (tree->move_score[preceding_move] >= score)
+    preceding_move = search->move_ordering[n - 1];
+    if (search->move_score[preceding_move] >= score)
       return;
 
     /* Swap move ordering. */
-    tree->move_ordering[n - 1] = move;
-    tree->move_ordering[n] = preceding_move;
-    tree->inverse_move_ordering[move] = n - 1;
-    tree->inverse_move_ordering[preceding_move] = n;
+    search->move_ordering[n - 1] = move;
+    search->move_ordering[n] = preceding_move;
+    search->inverse_move_ordering[move] = n - 1;
+    search->inverse_move_ordering[preceding_move] = n;
   }
 }
 
 
 static void
-uct_init_move_ordering(struct uct_tree *tree)
+uct_init_move_ordering(struct uct_search *search)
 {
   int pos;
   int k = 0;
   /* FIXME: Exclude forbidden moves. */
-  memset(tree->move_score, 0, sizeof(tree->move_score));
+  memset(search->move_score, 0, sizeof(search->move_score));
   for (pos = BOARDMIN; pos < BOARDMAX; pos++)
     if (ON_BOARD(pos)) {
-      tree->move_ordering[k] = pos;
-      tree->inverse_move_ordering[pos] = k;
+      search->move_ordering[k] = pos;
+      search->inverse_move_ordering[pos] = k;
       k++;
     }
   
-  tree->num_ordered_moves = k;
+  search->num_ordered_moves = k;
 
   /* FIXME: Quick and dirty experiment. */
   for (pos = BOARDMIN; pos < BOARDMAX; pos++) {
     if (ON_BOARD(pos)) {
-      tree->move_score[pos] = (int) (10 * potential_moves[pos]) - 1;
-      uct_update_move_ordering(tree, pos);
+      search->move_score[pos] = (int) (10 * potential_moves[pos]) - 1;
+      uct_update_move_ordering(search, pos);
     }
   }
 }
@@ -1915,7 +2049,7 @@ uct_finish_and_score_game(struct mc_game *game)
 }
 
 static struct uct_node *
-uct_play_move(struct uct_tree *tree, struct uct_node *node, float alpha,
+uct_play_move(struct uct_search *search, struct uct_node *node, float alpha,
 	      float *gamma, int *move)
 {
   struct uct_arc *child_arc;
@@ -1927,13 +2061,21 @@ uct_play_move(struct uct_tree *tree, struct uct_node *node, float alpha,
   
   for (child_arc = node->child; child_arc; child_arc = child_arc->next) {
     struct uct_node *child_node = child_arc->node;
-    float winrate = (float) child_node->wins / child_node->games;
+    float winrate;
     float uct_value;
-    float log_games_ratio = log(node->games) / child_node->games;
-    float x = winrate * (1.0 - winrate) + sqrt(2.0 * log_games_ratio);
+    float log_games_ratio;
+    float x;
+
+    /* Just added by another thread. */
+    if (child_node->games == 0)
+      continue;
+
+    winrate = (float) child_node->wins / child_node->games;
+    log_games_ratio = log(node->games) / child_node->games;
+    x = winrate * (1.0 - winrate) + sqrt(2.0 * log_games_ratio);
     if (x < 0.25)
       x = 0.25;
-    uct_value = winrate + sqrt(2 * log_games_ratio * x / (1 + tree->game.depth));
+    uct_value = winrate + sqrt(2 * log_games_ratio * x / (1 + search->game.depth));
     if (uct_value > best_uct_value) {
       next_arc = child_arc;
       best_uct_value = uct_value;
@@ -1951,24 +2093,27 @@ uct_play_move(struct uct_tree *tree, struct uct_node *node, float alpha,
   else {
     /* First play a random previously unplayed move, if any. */
     int k;
-    for (k = -1; k < tree->num_ordered_moves; k++) {
+    for (k = -1; k < search->num_ordered_moves; k++) {
+      unsigned int bit;
       if (k == -1 && best_uct_value > 0.0)
 	continue;
       else if (k == -1)
-	pos = mc_generate_random_move(&tree->game);
+	pos = mc_generate_random_move(&search->game);
       else
-	pos = tree->move_ordering[k];
-      
-      if (node->untested.bits[pos / 32] & (1 << (pos % 32))) {
+	pos = search->move_ordering[k];
+
+      /* Only one thread may take an untested move. */
+      bit = 1U << (pos % 32);
+      if ((node->untested.bits[pos / 32] & bit)
+	  && (uct_fetch_and_and(&node->untested.bits[pos / 32], ~bit) & bit)) {
 	int r;
 	int proper_small_eye = 1;
-	struct mc_board *mc = &tree->game.mc;
+	struct mc_board *mc = &search->game.mc;
 	*move = pos;
-	node->untested.bits[*move / 32] &= ~(1 << *move % 32);
 
 	for (r = 0; r < 4; r++) {
 	  if (mc->board[pos + delta[r]] == EMPTY
-	      || mc->board[pos + delta[r]] == OTHER_COLOR(tree->game.color_to_move)) {
+	      || mc->board[pos + delta[r]] == OTHER_COLOR(search->game.color_to_move)) {
 	    proper_small_eye = 0;
 	    break;
 	  }
@@ -1980,60 +2125,73 @@ uct_play_move(struct uct_tree *tree, struct uct_node *node, float alpha,
 	    int pos2 = pos + delta[r];
 	    if (!MC_ON_BOARD(pos2))
 	      diagonal_value++;
-	    else if (mc->board[pos2] == OTHER_COLOR(tree->game.color_to_move))
+	    else if (mc->board[pos2] == OTHER_COLOR(search->game.color_to_move))
 	      diagonal_value += 2;
 	  }
 	  if (diagonal_value > 3)
 	    proper_small_eye = 0;
 	}
 	
-	if (!proper_small_eye && mc_play_random_move(&tree->game, *move))
-	  return uct_find_node(tree, node, *move);
+	if (!proper_small_eye && mc_play_random_move(&search->game, *move))
+	  return uct_find_node(search, node, *move);
       }
     }
   }
   
   if (!next_arc) {
-    mc_play_random_move(&tree->game, PASS_MOVE);
+    mc_play_random_move(&search->game, PASS_MOVE);
     *move = PASS_MOVE;
-    return uct_find_node(tree, node, PASS_MOVE);
+    return uct_find_node(search, node, PASS_MOVE);
   }
 
   *move = next_arc->move;
-  mc_play_random_move(&tree->game, next_arc->move);
+  mc_play_random_move(&search->game, next_arc->move);
   
   return next_arc->node;
 }
 
 static float
-uct_traverse_tree(struct uct_tree *tree, struct uct_node *node,
+uct_traverse_tree(struct uct_search *search, struct uct_node *node,
 		  float alpha, float beta)
 {
-  int color = tree->game.color_to_move;
-  int num_passes = tree->game.consecutive_passes;
+  struct uct_tree *tree = search->tree;
+  int color = search->game.color_to_move;
+  int num_passes = search->game.consecutive_passes;
   float result;
   float gamma;
   int move = PASS_MOVE;
+  int games;
+
+  if (tree->virtual_loss)
+    games = uct_fetch_and_add(&node->games, 1);
+  else
+    games = node->games;
   
   /* FIXME: Unify these. */
-  if (num_passes == 3 || tree->game.depth >= UCT_MAX_SEARCH_DEPTH
-      || (node->games == 0 && node != tree->nodes))
-    result = uct_finish_and_score_game(&tree->game);
+  if (num_passes == 3 || search->game.depth >= UCT_MAX_SEARCH_DEPTH
+      || (games == 0 && node != tree->nodes))
+    result = uct_finish_and_score_game(&search->game);
   else {
     struct uct_node *next_node;
-    next_node = uct_play_move(tree, node, alpha, &gamma, &move);
-    
-    gamma += 0.00;
-    if (gamma > 0.8)
-      gamma = 0.8;
-    result = uct_traverse_tree(tree, next_node, beta, gamma);
+    next_node = uct_play_move(search, node, alpha, &gamma, &move);
+
+    /* Out of nodes, just finish the game. */
+    if (!next_node)
+      result = uct_finish_and_score_game(&search->game);
+    else {
+      gamma += 0.00;
+      if (gamma > 0.8)
+	gamma = 0.8;
+      result = uct_traverse_tree(search, next_node, beta, gamma);
+    }
   }
 
-  node->games++;
+  if (!tree->virtual_loss)
+    node->games++;
   if ((result > 0) ^ (color == WHITE)) {
-    node->wins++;
+    uct_fetch_and_add(&node->wins, 1);
     if (move != PASS_MOVE)
-      uct_update_move_ordering(tree, move);
+      uct_update_move_ordering(search, move);
   }
 
   node->sum_scores += result;
@@ -2042,6 +2200,89 @@ uct_traverse_tree(struct uct_tree *tree, struct uct_node *node,
   return result;
 }
 
+/* Play simulations from the starting position until the tree is
+ * within margin arcs of being full.
+ */
+static void
+uct_run_simulations(struct uct_search *search,
+		    const struct mc_game *starting_position, int margin)
+{
+  struct uct_tree *tree = search->tree;
+
+  /* Play simulations. FIXME: Terribly dirty fix. */
+  while (tree->num_used_arcs < tree->num_arcs - margin) {
+    int last_used_arcs = tree->num_used_arcs;
+    search->game = *starting_position;
+    search->game.random_state = search->random_state;
+    uct_traverse_tree(search, &tree->nodes[0], 1.0, 0.9);
+    /* FIXME: Ugly workaround for solved positions before running out
+     * of nodes.
+     */
+    if (tree->num_used_arcs == last_used_arcs)
+      break;
+  }
+}
+
+#if UCT_THREADS
+
+struct uct_thread {
+  struct uct_search search;
+  const struct mc_game *starting_position;
+  int margin;
+  pthread_t thread;
+};
+
+static void *
+uct_thread_main(void *data)
+{
+  struct uct_thread *thread = data;
+  uct_run_simulations(&thread->search, thread->starting_position,
+		      thread->margin);
+  return NULL;
+}
+
+/* Let num_threads threads, including this one, search the tree
+ * together. Each thread has its own game, move ordering and random
+ * number generator, seeded from the global one.
+ */
+static void
+uct_run_simulations_in_threads(struct uct_search *search,
+			       const struct mc_game *starting_position,
+			       int num_threads)
+{
+  struct uct_thread *threads = malloc(num_threads * sizeof(*threads));
+  int started[UCT_MAX_THREADS];
+  int k;
+
+  if (!threads) {
+    uct_run_simulations(search, starting_position, 10);
+    return;
+  }
+
+  search->tree->virtual_loss = 1;
+  for (k = 0; k < num_threads; k++) {
+    threads[k].search = *search;
+    gg_srand_r(&threads[k].search.own_random_state, gg_urand());
+    threads[k].search.random_state = &threads[k].search.own_random_state;
+    threads[k].starting_position = starting_position;
+    /* Threads may overshoot the limit while others are still adding. */
+    threads[k].margin = 10 * num_threads;
+  }
+
+  for (k = 1; k < num_threads; k++)
+    started[k] = (pthread_create(&threads[k].thread, NULL,
+				 uct_thread_main, &threads[k]) == 0);
+  uct_thread_main(&threads[0]);
+  for (k = 1; k < num_threads; k++)
+    if (started[k])
+      pthread_join(threads[k].thread, NULL);
+
+  search->tree->virtual_loss = 0;
+  free(threads);
+}
+
+#endif
+
 static int
 uct_find_best_children(struct uct_node *node, struct uct_arc **children,
 		       int n)
@@ -2111,11 +2352,226 @@ uct_dump_tree(struct uct_tree *tree, const char *filename, int color,
 }
 
 
+/* The search tree is kept between calls to uct_genmove(), so it is
+ * only allocated again when the number of nodes changes. With
+ * mc_reuse_tree set, the part of the previous tree below the new
+ * position is copied to the other arena and becomes the new tree, so
+ * that the search starts with the simulations already done there.
+ */
+static struct uct_tree uct_arenas[2];
+static int uct_current_arena = 0;
+
+/* Where the tree in the current arena was searched from. */
+static int uct_tree_valid = 0;
+static int uct_tree_color;
+static int uct_tree_board_size;
+static float uct_tree_komi;
+
+/* Allocate the tree for the given number of nodes, unless it already
+ * has that size, and empty it.
+ */
+static void
+uct_reset_tree(struct uct_tree *tree, int nodes)
+{
+  if (tree->num_nodes != nodes) {
+    free(tree->nodes);
+    free(tree->arcs);
+    free(tree->hashtable_odd);
+    free(tree->hashtable_even);
+    tree->nodes = malloc(nodes * sizeof(*tree->nodes));
+    gg_assert(tree->nodes);
+    tree->arcs = malloc(nodes * sizeof(*tree->arcs));
+    gg_assert(tree->arcs);
+    tree->hashtable_size = nodes;
+    tree->hashtable_odd = malloc(tree->hashtable_size
+				 * sizeof(*tree->hashtable_odd));
+    tree->hashtable_even = malloc(tree->hashtable_size
+				  * sizeof(*tree->hashtable_even));
+    gg_assert(tree->hashtable_odd);
+    gg_assert(tree->hashtable_even);
+    tree->num_nodes = nodes;
+    tree->num_arcs = nodes;
+  }
+
+  memset(tree->hashtable_odd, 0,
+	 tree->hashtable_size * sizeof(*tree->hashtable_odd));
+  memset(tree->hashtable_even, 0,
+	 tree->hashtable_size * sizeof(*tree->hashtable_even));
+  tree->num_used_nodes = 0;
+  tree->num_used_arcs = 0;
+  tree->virtual_loss = 0;
+}
+
+/* Look up a position in the hashtable for odd or even depth. Returns
+ * the index of its node, or 0 if it's not there, in which case *slot
+ * is set to the empty entry where it belongs. The root is never in
+ * the hashtables. Only used while no threads are searching.
+ */
+static int
+uct_lookup_node(struct uct_tree *tree, Hash_data *boardhash, int odd,
+		unsigned int **slot)
+{
+  unsigned int *hashtable = odd ? tree->hashtable_odd : tree->hashtable_even;
+  unsigned int hash_index = hashdata_remainder(*boardhash,
+					       tree->hashtable_size);
+
+  while (hashtable[hash_index] != 0) {
+    int node_index = hashtable[hash_index];
+    if (hashdata_is_equal(tree->nodes[node_index].boardhash, *boardhash))
+      return node_index;
+    hash_index++;
+    if (hash_index >= tree->hashtable_size)
+      hash_index = 0;
+  }
+
+  *slot = &hashtable[hash_index];
+  return 0;
+}
+
+/* Copy node with everything below it from one tree to another, where
+ * it is at odd or even depth. Nodes already in the target tree are
+ * not copied again. Moves that are forbidden now are dropped from the
+ * untested bits and the children of every node, and children of the
+ * root are only kept if the move is allowed now. The untested bits
+ * need no other masking since a node stands for the same position,
+ * with the same empty points, as in the previous tree. Returns NULL
+ * if the target tree is full.
+ */
+static struct uct_node *
+uct_copy_subtree(struct uct_tree *to, struct uct_node *node, int odd,
+		 const struct bitboard *playable, int *allowed_moves)
+{
+  int num_words = sizeof(node->untested.bits) / sizeof(node->untested.bits[0]);
+  unsigned int *slot = NULL;
+  struct uct_node *copy;
+  struct uct_arc **last;
+  struct uct_arc *arc;
+  int node_index;
+  int i;
+
+  if (to->num_used_nodes > 0) {
+    node_index = uct_lookup_node(to, &node->boardhash, odd, &slot);
+    if (node_index != 0)
+      return &to->nodes[node_index];
+  }
+
+  if (to->num_used_nodes >= to->num_nodes)
+    return NULL;
+  node_index = to->num_used_nodes++;
+  copy = &to->nodes[node_index];
+  *copy = *node;
+  copy->child = NULL;
+  for (i = 0; i < num_words; i++)
+    copy->untested.bits[i] &= playable->bits[i];
+  if (slot)
+    *slot = node_index;
+
+  last = &copy->child;
+  for (arc = node->child; arc; arc = arc->next) {
+    struct uct_node *child;
+    if (arc->move != PASS_MOVE
+	&& (to->forbidden_moves[arc->move]
+	    || (node_index == 0
+		&& allowed_moves && !allowed_moves[arc->move])))
+      continue;
+    if (to->num_used_arcs + 1 >= to->num_arcs)
+      break;
+    child = uct_copy_subtree(to, arc->node, !odd, playable, allowed_moves);
+    if (!child)
+      break;
+    *last = &to->arcs[to->num_used_arcs++];
+    (*last)->move = arc->move;
+    (*last)->node = child;
+    (*last)->next = NULL;
+    last = &(*last)->next;
+  }
+
+  return copy;
+}
+
+/* Find the node of the current position in the previous tree, if it
+ * was searched there.
+ */
+static struct uct_node *
+uct_find_previous_node(struct uct_search *search, int color, int nodes)
+{
+  struct uct_tree *tree = &uct_arenas[uct_current_arena];
+  Hash_data *boardhash = &search->game.mc.hash;
+  int odd = (color != uct_tree_color);
+  unsigned int *slot;
+  int node_index;
+
+  if (!uct_tree_valid
+      || tree->num_nodes != nodes
+      || uct_tree_board_size != board_size
+      || uct_tree_komi != komi)
+    return NULL;
+
+  if (!odd && hashdata_is_equal(tree->nodes[0].boardhash, *boardhash))
+    return &tree->nodes[0];
+
+  node_index = uct_lookup_node(tree, boardhash, odd, &slot);
+  if (node_index == 0)
+    return NULL;
+  return &tree->nodes[node_index];
+}
+
+/* Set up the tree for a search of the current position, with the
+ * previous search of this position as a start if mc_reuse_tree is set.
+ */
+static void
+uct_prepare_tree(struct uct_search *search, int color, int nodes,
+		 int *forbidden_moves, int *allowed_moves)
+{
+  struct uct_node *previous = NULL;
+  struct uct_tree *tree;
+  struct uct_arc *arc;
+
+  if (mc_reuse_tree) {
+    previous = uct_find_previous_node(search, color, nodes);
+    if (previous)
+      uct_current_arena = 1 - uct_current_arena;
+  }
+
+  tree = &uct_arenas[uct_current_arena];
+  uct_reset_tree(tree, nodes);
+  tree->forbidden_moves = forbidden_moves;
+  search->tree = tree;
+
+  if (previous) {
+    struct bitboard playable;
+    struct uct_node *root;
+    int pos;
+
+    memset(playable.bits, 0, sizeof(playable.bits));
+    for (pos = BOARDMIN; pos < BOARDMAX; pos++)
+      if (!forbidden_moves[pos])
+	playable.bits[pos / 32] |= 1U << pos % 32;
+
+    root = uct_copy_subtree(tree, previous, 0, &playable, allowed_moves);
+    /* Moves already searched are not untested. */
+    uct_init_untested(search, root, allowed_moves);
+    for (arc = root->child; arc; arc = arc->next)
+      root->untested.bits[arc->move / 32] &= ~(1U << arc->move % 32);
+    if (mc_debug)
+      gprintf("Reusing %d nodes, %d games of the previous search\n",
+	      tree->num_used_nodes, root->games);
+  }
+  else
+    uct_init_node(search, allowed_moves);
+
+  uct_tree_valid = 1;
+  uct_tree_color = color;
+  uct_tree_board_size = board_size;
+  uct_tree_komi = komi;
+}
+
 void
 uct_genmove(int color, int *move, int *forbidden_moves, int *allowed_moves,
 	    int nodes, float *move_values, int *move_frequencies)
 {
-  struct uct_tree tree;
+  struct uct_tree *tree;
+  struct uct_search search;
   float best_score;
   struct uct_arc *arc;
   struct uct_node *node;
@@ -2133,46 +2589,28 @@ uct_genmove(int color, int *move, int *forbidden_moves, int *allowed_moves,
   starting_position.consecutive_ko_captures = 0;
   starting_position.last_move = get_last_move();
   starting_position.depth = 0;
+  starting_position.random_state = NULL;
   for (pos = BOARDMIN; pos < BOARDMAX; pos++)
     starting_position.settled[pos] = forbidden_moves[pos];
 
-  tree.game = starting_position;
-  /* FIXME: Don't reallocate between moves. */
-  tree.nodes = malloc(nodes * sizeof(*tree.nodes));
-  gg_assert(tree.nodes);
-  tree.arcs = malloc(nodes * sizeof(*tree.arcs));
-  gg_assert(tree.arcs);
-  tree.hashtable_size = nodes;
-  tree.hashtable_odd = calloc(tree.hashtable_size,
-			      sizeof(*tree.hashtable_odd));
-  tree.hashtable_even = calloc(tree.hashtable_size,
-			       sizeof(*tree.hashtable_even));
-  gg_assert(tree.hashtable_odd);
-  gg_assert(tree.hashtable_even);
-  tree.num_nodes = nodes;
-  tree.num_arcs = nodes;
-  tree.num_used_nodes = 0;
-  tree.num_used_arcs = 0;
-  tree.forbidden_moves = forbidden_moves;
-  uct_init_node(&tree, allowed_moves);
-  uct_init_move_ordering(&tree);
-
-  /* Play simulations. FIXME: Terribly dirty fix. */
-  while (tree.num_used_arcs < tree.num_arcs - 10) {
-    int last_used_arcs = tree.num_used_arcs;
-    tree.game = starting_position;
-    uct_traverse_tree(&tree, &tree.nodes[0], 1.0, 0.9);
-    /* FIXME: Ugly workaround for solved positions before running out
-     * of nodes.
-     */
-    if (tree.num_used_arcs == last_used_arcs)
-      break;
-  }
+  search.game = starting_position;
+  search.random_state = NULL;
+  uct_prepare_tree(&search, color, nodes, forbidden_moves, allowed_moves);
+  tree = search.tree;
+  uct_init_move_ordering(&search);
+
+#if UCT_THREADS
+  if (mc_threads > 1)
+    uct_run_simulations_in_threads(&search, &starting_position,
+				   gg_min(mc_threads, UCT_MAX_THREADS));
+  else
+#endif
+    uct_run_simulations(&search, &starting_position, 10);
 
   /* Identify the best move on the top level. */
   best_score = 0.0;
   *move = PASS_MOVE;
-  for (arc = tree.nodes[0].child; arc; arc = arc->next) {
+  for (arc = tree->nodes[0].child; arc; arc = arc->next) {
     node = arc->node;
     move_frequencies[arc->move] = node->games;
     move_values[arc->move] = (float) node->wins / node->games;
@@ -2184,7 +2622,7 @@ uct_genmove(int color, int *move, int *forbidden_moves, int *allowed_moves,
 
   /* Dump sgf tree of the significant part of the search tree. */
   if (0)
-    uct_dump_tree(&tree, "/tmp/ucttree.sgf", color, 50);
+    uct_dump_tree(tree, "/tmp/ucttree.sgf", color, 50);
     
   /* Print information about the search tree. */
   if (mc_debug) {
@@ -2196,7 +2634,7 @@ uct_genmove(int color, int *move, int *forbidden_moves, int *allowed_moves,
       most_games_node = NULL;
       most_games_arc = NULL;
       
-      for (arc = tree.nodes[0].child; arc; arc = arc->next) {
+      for (arc = tree->nodes[0].child; arc; arc = arc->next) {
 	node = arc->node;
 	if (most_games < node->games) {
 	  most_games = node->games;
@@ -2217,14 +2655,14 @@ uct_genmove(int color, int *move, int *forbidden_moves, int *allowed_moves,
 	      mean, std, mean / (std + 0.001));
       most_games_node->games = -most_games_node->games;
     }
-    for (arc = tree.nodes[0].child; arc; arc = arc->next)
+    for (arc = tree->nodes[0].child; arc; arc = arc->next)
       arc->node->games = -arc->node->games;
     
     {
       int n;
       struct uct_arc *arcs[7];
       int depth = 0;
-      n = uct_find_best_children(&tree.nodes[0], arcs, 7);
+      n = uct_find_best_children(&tree->nodes[0], arcs, 7);
       gprintf("Principal variation:\n");
       while (n > 0 && depth < 80) {
 	int k;
@@ -2246,11 +2684,6 @@ uct_genmove(int color, int *move, int *forbidden_moves, int *allowed_moves,
       gprintf("\n");
     }
   }
-  
-  free(tree.nodes);
-  free(tree.arcs);
-  free(tree.hashtable_odd);
-  free(tree.hashtable_even);
 }
 
 
@@ -67,25 +67,33 @@
 #define MAX_ESCAPE 3  /* After this many escape moves, owl_determine_life is */
                       /*    not called                                       */
 
+/* The board sized arrays are reached through pointers. A pushed entry
+ * of the owl stack shares them with the entry below it and only gets
+ * its own copy in the *_storage arrays when it changes them, see
+ * own_owl_array(). The initialization functions always work on
+ * entries using their own storage.
+ */
 struct local_owl_data {
-  signed char goal[BOARDMAX];
-  signed char boundary[BOARDMAX];
+  signed char *goal;
+  signed char *boundary;
   /* Same as goal, except never anything is removed from it. */
-  signed char cumulative_goal[BOARDMAX];
+  signed char *cumulative_goal;
 
-  /* FIXME: neighbors[] and escape_values[] are never recomputed.
-   *	    Consider moving these arrays from stack to a static or
-   *	    dynamic variable so it is not copied around in
-   *	    do_push_owl().  Be aware of semeai code though.
+  /* neighbors[] and escape_values[] are never recomputed after the
+   * initialization, so they are shared by the whole stack.
    */
-  signed char neighbors[BOARDMAX];
+  signed char *neighbors;
 
-  signed char escape_values[BOARDMAX];
+  signed char *escape_values;
   int color;
 
-  struct eye_data my_eye[BOARDMAX];
+  /* Eye data, computed into my_eye_storage and half_eye_storage.
+   * When do_owl_defend() skips the computation, the entry uses the
+   * eye data of the entry below it instead.
+   */
+  struct eye_data *my_eye;
   /* array of half-eye data for use during owl reading */
-  struct half_eye_data half_eye[BOARDMAX];
+  struct half_eye_data *half_eye;
   
   int lunch[MAX_LUNCHES];
   int lunch_attack_code[MAX_LUNCHES];
@@ -100,6 +108,14 @@ struct local_owl_data {
 
   /* This is used to organize the owl stack. */
   struct local_owl_data *restore_from;
+
+  signed char goal_storage[BOARDMAX];
+  signed char boundary_storage[BOARDMAX];
+  signed char cumulative_goal_storage[BOARDMAX];
+  signed char neighbors_storage[BOARDMAX];
+  signed char escape_values_storage[BOARDMAX];
+  struct eye_data my_eye_storage[BOARDMAX];
+  struct half_eye_data half_eye_storage[BOARDMAX];
 };
 
 
@@ -303,6 +319,8 @@ static struct local_owl_data *owl_stack[2 * MAXSTACK];
 static int owl_stack_size = 0;
 static int owl_stack_pointer = 0;
 static void check_owl_stack_size(void);
+static signed char *own_owl_array(signed char *array,
+				  signed char storage[BOARDMAX]);
 static void push_owl(struct local_owl_data **owl);
 static void do_push_owl(struct local_owl_data **owl);
 static void pop_owl(struct local_owl_data **owl);
@@ -2295,6 +2313,7 @@ do_owl_attack(int str, int *move, int *wormid,
 
       /* Test whether the move cut the goal dragon apart. */
       if (moves[k].cuts[0] != NO_MOVE && origin != NO_MOVE) {
+	owl->goal = own_owl_array(owl->goal, owl->goal_storage);
 	owl_test_cuts(owl->goal, owl->color, moves[k].cuts);
 	if (!owl->goal[origin])
 	  origin = select_new_goal_origin(origin, owl);
@@ -2716,8 +2735,8 @@ do_owl_defend(int str, int *move, int *wormid, struct local_owl_data *owl,
      * previous depth level. It should be reasonably close to the actual
      * state of eyes.
      */
-    memcpy(owl->my_eye, owl->restore_from->my_eye, sizeof(owl->my_eye));
-    memcpy(owl->half_eye, owl->restore_from->half_eye, sizeof(owl->half_eye));
+    owl->my_eye = owl->restore_from->my_eye;
+    owl->half_eye = owl->restore_from->half_eye;
 
     vital_moves[0].pos = 0;
     vital_moves[0].value = -1;
@@ -3211,6 +3230,7 @@ owl_determine_life(struct local_owl_data *owl,
   owl_find_relevant_eyespaces(owl, mw, mz);
 
   /* Reset halfeye data. Set topological eye value to something big. */
+  owl->half_eye = owl->half_eye_storage;
   for (pos = BOARDMIN; pos < BOARDMAX; pos++) {
     if (ON_BOARD(pos)) {
       owl->half_eye[pos].type = 0;
@@ -4727,7 +4747,7 @@ owl_mark_dragon(int apos, int bpos, struct local_owl_data *owl,
       }
   }
 
-  memcpy(owl->cumulative_goal, owl->goal, sizeof(owl->goal));
+  memcpy(owl->cumulative_goal, owl->goal, BOARDMAX);
   owl->color = color;
   owl_mark_boundary(owl);
 }
@@ -4745,8 +4765,8 @@ owl_mark_boundary(struct local_owl_data *owl)
   int color = owl->color;
   int other = OTHER_COLOR(color);
   
-  memset(owl->boundary, 0, sizeof(owl->boundary));
-  memset(owl->neighbors, 0, sizeof(owl->neighbors));
+  memset(owl->boundary, 0, BOARDMAX);
+  memset(owl->neighbors, 0, BOARDMAX);
 
   /* Find all friendly neighbors of the dragon in goal. */
   for (pos = BOARDMIN; pos < BOARDMAX; pos++) {
@@ -4860,6 +4880,9 @@ owl_update_goal(int pos, enum same_dragon_value same_dragon, int lunch,
   SGFTree *save_sgf_dumptree = sgf_dumptree;
   int save_count_variations = count_variations;
   
+  owl->goal = own_owl_array(owl->goal, owl->goal_storage);
+  owl->cumulative_goal = own_owl_array(owl->cumulative_goal,
+				       owl->cumulative_goal_storage);
 
   /* Turn off sgf output during find_superstring(). */
   sgf_dumptree = NULL;
@@ -5158,6 +5181,7 @@ owl_update_boundary_marks(int pos, struct local_owl_data *owl)
       boundary_mark = 2;
   }
 
+  owl->boundary = own_owl_array(owl->boundary, owl->boundary_storage);
   mark_string(pos, owl->boundary, boundary_mark);
 }
 
@@ -6233,6 +6257,9 @@ owl_make_domains(struct local_owl_data *owla, struct local_owl_data *owlb)
   current_owl_data = owla;
   other_owl_data = owlb;
 
+  /* The eye data is computed from scratch by make_domains(). */
+  owla->my_eye = owla->my_eye_storage;
+
   if (!owla->lunches_are_current)
     owl_find_lunches(owla);
   if (owla->color == BLACK)
@@ -6368,7 +6395,7 @@ owl_substantial(int str)
   if (liberties > MAX_SUBSTANTIAL_LIBS)
     return 0;
 
-  memset(owl->goal, 0, sizeof(owl->goal));
+  memset(owl->goal, 0, BOARDMAX);
   /* Mark the neighbors of the string. If one is found which is alive, return
    * true. */
   {
@@ -6997,6 +7024,13 @@ reduced_init_owl(struct local_owl_data **owl, int at_bottom_of_stack)
   check_owl_stack_size();
   *owl = owl_stack[owl_stack_pointer];
   VALGRIND_MAKE_WRITABLE(*owl, sizeof(struct local_owl_data));
+  (*owl)->goal = (*owl)->goal_storage;
+  (*owl)->boundary = (*owl)->boundary_storage;
+  (*owl)->cumulative_goal = (*owl)->cumulative_goal_storage;
+  (*owl)->neighbors = (*owl)->neighbors_storage;
+  (*owl)->escape_values = (*owl)->escape_values_storage;
+  (*owl)->my_eye = (*owl)->my_eye_storage;
+  (*owl)->half_eye = (*owl)->half_eye_storage;
 }
 
 
@@ -7034,6 +7068,18 @@ check_owl_stack_size(void)
   }
 }
 
+/* Return storage after copying array to it, unless array already is
+ * storage. Used before an array shared with a lower stack entry is
+ * changed.
+ */
+static signed char *
+own_owl_array(signed char *array, signed char storage[BOARDMAX])
+{
+  if (array != storage)
+    memcpy(storage, array, BOARDMAX);
+  return storage;
+}
+
 /* Push owl data one step upwards in the stack. Gets called from
  * push_owl.
  */
@@ -7044,14 +7090,14 @@ do_push_owl(struct local_owl_data **owl)
 
   /* Mark all the data in *new_owl as uninitialized. */
   VALGRIND_MAKE_WRITABLE(new_owl, sizeof(struct local_owl_data));
-  /* Copy the owl data. */
-  memcpy(new_owl->goal, (*owl)->goal, sizeof(new_owl->goal));
-  memcpy(new_owl->cumulative_goal, (*owl)->cumulative_goal,
-         sizeof(new_owl->cumulative_goal));
-  memcpy(new_owl->boundary, (*owl)->boundary, sizeof(new_owl->boundary));
-  memcpy(new_owl->neighbors, (*owl)->neighbors, sizeof(new_owl->neighbors));
-  memcpy(new_owl->escape_values, (*owl)->escape_values,
-	 sizeof(new_owl->escape_values));
+  /* Share the owl data until it is changed. */
+  new_owl->goal = (*owl)->goal;
+  new_owl->cumulative_goal = (*owl)->cumulative_goal;
+  new_owl->boundary = (*owl)->boundary;
+  new_owl->neighbors = (*owl)->neighbors;
+  new_owl->escape_values = (*owl)->escape_values;
+  new_owl->my_eye = new_owl->my_eye_storage;
+  new_owl->half_eye = new_owl->half_eye_storage;
   new_owl->color = (*owl)->color;
 
   new_owl->lunches_are_current = 0;
@@ -106,6 +106,8 @@ struct persistent_cache_entry {
   int move2;/* second result coordinate */
   int cost; /* Usually no. of tactical nodes spent on this reading result. */
   int score; /* Heuristic guess of the worth of the cache entry. */
+  int bucket; /* Index bucket, computed from routine, targets and goal. */
+  int next; /* Next entry in the same bucket, or -1. */
 };
 
 /* Callback function that implements the computation of the active area.
@@ -124,6 +126,8 @@ struct persistent_cache {
   struct persistent_cache_entry *table; /* Array of actual results. */
   int current_size; /* Current number of entries. */
   int last_purge_position_number;
+  int *index; /* First entry of each bucket, or -1. */
+  int index_size; /* Number of buckets, a power of two. */
 };
 
 static void compute_active_owl_area(struct persistent_cache_entry *entry,
@@ -309,6 +313,76 @@ print_persistent_cache(struct persistent_cache *cache)
  * function below.
  */
 
+/* The entries are indexed by routine, input coordinates and goal
+ * hash, so that a lookup only has to verify the stored boards of
+ * the few entries reading the same thing. Entries with equal keys
+ * are chained through the next field. The active area is not part
+ * of the key since it isn't known until an entry has been found.
+ */
+static int
+persistent_cache_bucket(struct persistent_cache *cache,
+			enum routine_id routine, int apos, int bpos,
+			int cpos, int color, Hash_data *goal_hash)
+{
+  unsigned int key = routine;
+  key = key * 1000003U + apos;
+  key = key * 1000003U + bpos;
+  key = key * 1000003U + cpos;
+  key = key * 1000003U + color;
+  if (goal_hash)
+    key ^= (unsigned int) goal_hash->hashval[0];
+  key ^= key >> 15;
+  key *= 0x9e3779b1U;
+  return (key >> 12) & (cache->index_size - 1);
+}
+
+/* Enter entry k, whose bucket field has been set, into the index. */
+static void
+link_persistent_cache_entry(struct persistent_cache *cache, int k)
+{
+  struct persistent_cache_entry *entry = &(cache->table[k]);
+  entry->next = cache->index[entry->bucket];
+  cache->index[entry->bucket] = k;
+}
+
+/* Remove entry k from the index. */
+static void
+unlink_persistent_cache_entry(struct persistent_cache *cache, int k)
+{
+  int *link = &(cache->index[cache->table[k].bucket]);
+  while (*link != k) {
+    gg_assert(*link != -1);
+    link = &(cache->table[*link].next);
+  }
+  *link = cache->table[k].next;
+}
+
+/* Remove entry k from the cache by moving the last entry into its
+ * place.
+ */
+static void
+remove_persistent_cache_entry(struct persistent_cache *cache, int k)
+{
+  int last = cache->current_size - 1;
+  unlink_persistent_cache_entry(cache, k);
+  if (k < last) {
+    unlink_persistent_cache_entry(cache, last);
+    cache->table[k] = cache->table[last];
+    link_persistent_cache_entry(cache, k);
+  }
+  cache->current_size--;
+}
+
+/* Discard all entries of the cache. */
+static void
+empty_persistent_cache(struct persistent_cache *cache)
+{
+  int k;
+  for (k = 0; k < cache->index_size; k++)
+    cache->index[k] = -1;
+  cache->current_size = 0;
+}
+
 /* Remove persistent cache entries which are no longer compatible with
  * the board. For efficient use of the cache, it's recommended to call
  * this function once per move, before starting the owl reading. It's
@@ -357,10 +431,8 @@ purge_persistent_cache(struct persistent_cache *cache)
        */
       if (0)
 	gprintf("Purging entry %d from cache.\n", k);
-      if (k < cache->current_size - 1)
-	*entry = cache->table[cache->current_size - 1];
+      remove_persistent_cache_entry(cache, k);
       k--;
-      cache->current_size--;
     }
     else {
       /* Reduce score here to penalize entries getting old. */
@@ -378,6 +450,9 @@ purge_persistent_cache(struct persistent_cache *cache)
 /* Find a cache entry matching the data given in the parameters.
  * Important: We assume that unused parameters are normalized to NO_MOVE
  * when storing or retrieving, so that we can ignore them here.
+ *
+ * If several entries match, the one earliest in the table is
+ * returned.
  */ 
 static struct persistent_cache_entry *
 find_persistent_cache_entry(struct persistent_cache *cache,
@@ -385,10 +460,14 @@ find_persistent_cache_entry(struct persistent_cache *cache,
 			    int cpos, int color,
 			    Hash_data *goal_hash, int node_limit)
 {
+  int bucket = persistent_cache_bucket(cache, routine, apos, bpos, cpos,
+				       color, goal_hash);
+  int best = -1;
   int k;
-  for (k = 0; k < cache->current_size; k++) {
+  for (k = cache->index[bucket]; k != -1; k = cache->table[k].next) {
     struct persistent_cache_entry *entry = cache->table + k;
-    if (entry->routine == routine
+    if ((best == -1 || k < best)
+	&& entry->routine == routine
 	&& entry->apos == apos
 	&& entry->bpos == bpos
 	&& entry->cpos == cpos
@@ -398,9 +477,11 @@ find_persistent_cache_entry(struct persistent_cache *cache,
         && (goal_hash == NULL
 	    || hashdata_is_equal(entry->goal_hash, *goal_hash))
         && verify_stored_board(entry->board))
-      return entry;
+      best = k;
   }
-  return NULL;
+  if (best == -1)
+    return NULL;
+  return cache->table + best;
 }
 
 /* Search through a persistent cache. Returns 0 if no matching entry was
@@ -494,9 +575,7 @@ store_persistent_cache(struct persistent_cache *cache,
     if (worst_entry != -1) {
       /* Move the last entry in the cache here to make space.
        */
-      if (worst_entry < cache->current_size - 1)
-	cache->table[worst_entry] = cache->table[cache->current_size - 1];
-      cache->current_size--;
+      remove_persistent_cache_entry(cache, worst_entry);
     }
     else
       return;
@@ -521,6 +600,8 @@ store_persistent_cache(struct persistent_cache *cache,
   entry->score 		 = cost;
   entry->cost 		 = cost;
   entry->movenum 	 = movenum;
+  entry->bucket		 = persistent_cache_bucket(cache, routine, apos, bpos,
+						   cpos, color, goal_hash);
 
   for (r = 0; r < MAX_CACHE_DEPTH; r++) {
     if (r < stackp)
@@ -534,6 +615,7 @@ store_persistent_cache(struct persistent_cache *cache,
   /* Remains to set the board. */
   cache->compute_active_area(&(cache->table[cache->current_size]),
       			     goal, goal_color);
+  link_persistent_cache_entry(cache, cache->current_size);
   cache->current_size++;
 
   if (debug & DEBUG_PERSISTENT_CACHE) {
@@ -548,16 +630,31 @@ store_persistent_cache(struct persistent_cache *cache,
 /* Interface functions relevant to all caches.			    */
 /* ================================================================ */
 
-/* Allocate the actual cache table. */
+/* Allocate the actual cache table, unless this has already been done,
+ * and discard all entries.
+ */
 static void
 init_cache(struct persistent_cache *cache)
 {
-  cache->table = malloc(cache->max_size*sizeof(struct persistent_cache_entry));
-  gg_assert(cache->table);
+  if (cache->table == NULL) {
+    cache->table = malloc(cache->max_size
+			  * sizeof(struct persistent_cache_entry));
+    gg_assert(cache->table);
+
+    /* Use at least twice as many buckets as entries. */
+    cache->index_size = 1;
+    while (cache->index_size < 2 * cache->max_size)
+      cache->index_size *= 2;
+    cache->index = malloc(cache->index_size * sizeof(int));
+    gg_assert(cache->index);
+  }
+  empty_persistent_cache(cache);
+  cache->last_purge_position_number = -1;
 }
 
 /* Initializes all persistent caches.
- * Needs to be called only once at startup.
+ * Needs to be called only once at startup, but calling it again only
+ * empties the caches.
  */
 void
 persistent_cache_init()
@@ -574,11 +671,11 @@ persistent_cache_init()
 void
 clear_persistent_caches()
 {
-  reading_cache.current_size = 0;
-  connection_cache.current_size = 0;
-  breakin_cache.current_size = 0;
-  owl_cache.current_size = 0;
-  semeai_cache.current_size = 0;
+  empty_persistent_cache(&reading_cache);
+  empty_persistent_cache(&connection_cache);
+  empty_persistent_cache(&breakin_cache);
+  empty_persistent_cache(&owl_cache);
+  empty_persistent_cache(&semeai_cache);
 }
 
 /* Discards all persistent cache entries that are no longer useful. 
@@ -595,6 +692,394 @@ purge_persistent_caches()
   purge_persistent_cache(&semeai_cache);
 }
 
+/* ================================================================ */
+/*                  Saving and restoring the caches                 */
+/* ================================================================ */
+
+/* The caches can be written to a binary blob and read back later,
+ * possibly by another process, so that results read during an earlier
+ * session are available right away. The blob starts with the line
+ *
+ *   GNU Go persistent caches <version> <MAX_BOARD>
+ *
+ * since board positions are stored as they are and only make sense
+ * with the same MAX_BOARD. Then for each cache, in the order of
+ * all_caches[] below, follows the number of entries and the entries.
+ * All integers are stored as 4 bytes, most significant byte first.
+ * The stored board of an entry is only written for the points of
+ * its board size, the other points are restored as GRAY.
+ *
+ * Stored entries are verified against the board before they are
+ * used, just like entries read in this session, so entries from
+ * other games are harmless and purged at the next move.
+ */
+
+#define PERSISTENT_CACHE_VERSION 1
+
+/* Size in bytes of a goal hash in the blob. */
+#define CACHE_HASH_BYTES ((NUM_HASHBITS + 7) / 8)
+
+/* Integers of an entry, apart from its move stack. */
+#define CACHE_ENTRY_INTS 16
+
+static struct persistent_cache *all_caches[] = {
+  &reading_cache, &connection_cache, &breakin_cache,
+  &owl_cache, &semeai_cache
+};
+
+#define NUM_CACHES ((int) (sizeof(all_caches) / sizeof(all_caches[0])))
+
+static unsigned char *
+write_cache_int(unsigned char *p, int value)
+{
+  unsigned int v = (unsigned int) value;
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+  return p + 4;
+}
+
+static int
+read_cache_int(const unsigned char *p)
+{
+  return (int) (((unsigned int) p[0] << 24) | ((unsigned int) p[1] << 16)
+		| ((unsigned int) p[2] << 8) | (unsigned int) p[3]);
+}
+
+/* Number of bytes needed for an entry in the blob. */
+static int
+cache_entry_bytes(int size)
+{
+  return 4 * (CACHE_ENTRY_INTS + 2 * MAX_CACHE_DEPTH) + CACHE_HASH_BYTES
+	 + size * size;
+}
+
+static void
+write_cache_header(char *header)
+{
+  sprintf(header, "GNU Go persistent caches %d %d\n",
+	  PERSISTENT_CACHE_VERSION, MAX_BOARD);
+}
+
+/* Return the goal hash of an entry, or NULL if the cache doesn't use
+ * goal hashes.
+ */
+static Hash_data *
+stored_goal_hash(struct persistent_cache *cache,
+		 struct persistent_cache_entry *entry)
+{
+  if (cache == &breakin_cache || cache == &semeai_cache)
+    return &(entry->goal_hash);
+  return NULL;
+}
+
+static unsigned char *
+write_cache_entry(unsigned char *p, struct persistent_cache *cache,
+		  struct persistent_cache_entry *entry)
+{
+  int bits_in_hashvalue = CHAR_BIT * SIZEOF_HASHVALUE;
+  int i, j, k, r;
+
+  p = write_cache_int(p, entry->boardsize);
+  p = write_cache_int(p, entry->movenum);
+  p = write_cache_int(p, entry->routine);
+  p = write_cache_int(p, entry->apos);
+  p = write_cache_int(p, entry->bpos);
+  p = write_cache_int(p, entry->cpos);
+  p = write_cache_int(p, entry->color);
+  p = write_cache_int(p, entry->result);
+  p = write_cache_int(p, entry->result2);
+  p = write_cache_int(p, entry->result_certain);
+  p = write_cache_int(p, entry->remaining_depth);
+  p = write_cache_int(p, entry->node_limit);
+  p = write_cache_int(p, entry->move);
+  p = write_cache_int(p, entry->move2);
+  p = write_cache_int(p, entry->cost);
+  p = write_cache_int(p, entry->score);
+  for (r = 0; r < MAX_CACHE_DEPTH; r++) {
+    p = write_cache_int(p, entry->stack[r]);
+    p = write_cache_int(p, entry->move_color[r]);
+  }
+
+  /* The goal hash is only set by the caches using it. */
+  memset(p, 0, CACHE_HASH_BYTES);
+  if (stored_goal_hash(cache, entry)) {
+    for (k = 0; k < NUM_HASHBITS; k++) {
+      Hashvalue value = entry->goal_hash.hashval[k / bits_in_hashvalue];
+      int bit = (value >> (bits_in_hashvalue - 1 - k % bits_in_hashvalue)) & 1;
+      p[k / 8] |= bit << (7 - k % 8);
+    }
+  }
+  p += CACHE_HASH_BYTES;
+
+  for (i = 0; i < entry->boardsize; i++)
+    for (j = 0; j < entry->boardsize; j++)
+      *p++ = entry->board[POS(i, j)];
+
+  return p;
+}
+
+/* Read an entry of the blob, checking that all values are in range.
+ * Return a pointer past the entry or NULL if it is malformed.
+ */
+static const unsigned char *
+read_cache_entry(const unsigned char *p, const unsigned char *end,
+		 struct persistent_cache_entry *entry)
+{
+  int bits_in_hashvalue = CHAR_BIT * SIZEOF_HASHVALUE;
+  int positions[5 + MAX_CACHE_DEPTH];
+  int i, j, k, r;
+
+  if (end - p < 4)
+    return NULL;
+  entry->boardsize = read_cache_int(p);
+  if (entry->boardsize < MIN_BOARD || entry->boardsize > MAX_BOARD
+      || end - p < cache_entry_bytes(entry->boardsize))
+    return NULL;
+
+  entry->movenum         = read_cache_int(p + 4);
+  entry->routine         = read_cache_int(p + 8);
+  entry->apos            = read_cache_int(p + 12);
+  entry->bpos            = read_cache_int(p + 16);
+  entry->cpos            = read_cache_int(p + 20);
+  entry->color           = read_cache_int(p + 24);
+  entry->result          = read_cache_int(p + 28);
+  entry->result2         = read_cache_int(p + 32);
+  entry->result_certain  = read_cache_int(p + 36);
+  entry->remaining_depth = read_cache_int(p + 40);
+  entry->node_limit      = read_cache_int(p + 44);
+  entry->move            = read_cache_int(p + 48);
+  entry->move2           = read_cache_int(p + 52);
+  entry->cost            = read_cache_int(p + 56);
+  entry->score           = read_cache_int(p + 60);
+  p += 4 * CACHE_ENTRY_INTS;
+  for (r = 0; r < MAX_CACHE_DEPTH; r++) {
+    entry->stack[r] = read_cache_int(p);
+    entry->move_color[r] = read_cache_int(p + 4);
+    p += 8;
+    if (entry->move_color[r] < EMPTY || entry->move_color[r] > BLACK)
+      return NULL;
+  }
+
+  if ((unsigned) entry->routine >= NUM_CACHE_ROUTINES
+      || entry->color < EMPTY || entry->color > BLACK)
+    return NULL;
+
+  positions[0] = entry->apos;
+  positions[1] = entry->bpos;
+  positions[2] = entry->cpos;
+  positions[3] = entry->move;
+  positions[4] = entry->move2;
+  for (r = 0; r < MAX_CACHE_DEPTH; r++)
+    positions[5 + r] = entry->stack[r];
+  for (k = 0; k < 5 + MAX_CACHE_DEPTH; k++)
+    if (positions[k] < 0 || positions[k] >= BOARDMAX)
+      return NULL;
+
+  memset(&entry->goal_hash, 0, sizeof(entry->goal_hash));
+  for (k = 0; k < NUM_HASHBITS; k++) {
+    int bit = (p[k / 8] >> (7 - k % 8)) & 1;
+    entry->goal_hash.hashval[k / bits_in_hashvalue]
+      |= (Hashvalue) bit << (bits_in_hashvalue - 1 - k % bits_in_hashvalue);
+  }
+  p += CACHE_HASH_BYTES;
+
+  for (k = 0; k < BOARDMAX; k++)
+    entry->board[k] = GRAY;
+  for (i = 0; i < entry->boardsize; i++)
+    for (j = 0; j < entry->boardsize; j++) {
+      if (*p > (GRAY | HIGH_LIBERTY_BIT | HIGH_LIBERTY_BIT2))
+	return NULL;
+      entry->board[POS(i, j)] = *p++;
+    }
+
+  return p;
+}
+
+/* Write the contents of all persistent caches to data. Return the
+ * number of bytes needed. If that is more than length, nothing is
+ * written, so the caller can call again with NULL and 0 to learn the
+ * size.
+ */
+int
+export_persistent_caches(char *data, int length)
+{
+  char header[64];
+  unsigned char *p;
+  int size;
+  int c, k;
+
+  write_cache_header(header);
+  size = strlen(header);
+  for (c = 0; c < NUM_CACHES; c++) {
+    size += 4;
+    for (k = 0; k < all_caches[c]->current_size; k++)
+      size += cache_entry_bytes(all_caches[c]->table[k].boardsize);
+  }
+
+  if (data == NULL || size > length)
+    return size;
+
+  memcpy(data, header, strlen(header));
+  p = (unsigned char *) data + strlen(header);
+  for (c = 0; c < NUM_CACHES; c++) {
+    struct persistent_cache *cache = all_caches[c];
+    p = write_cache_int(p, cache->current_size);
+    for (k = 0; k < cache->current_size; k++)
+      p = write_cache_entry(p, cache, &(cache->table[k]));
+  }
+  gg_assert(p == (unsigned char *) data + size);
+
+  return size;
+}
+
+/* Return 1 if the cache already holds an entry equal to entry, i.e.
+ * one storing the same reading with the same active area.
+ */
+static int
+known_persistent_cache_entry(struct persistent_cache *cache,
+			     struct persistent_cache_entry *entry)
+{
+  Hash_data *goal_hash = stored_goal_hash(cache, entry);
+  int i, j, k, r;
+
+  for (k = cache->index[entry->bucket]; k != -1; k = cache->table[k].next) {
+    struct persistent_cache_entry *other = cache->table + k;
+    int same = (other->boardsize == entry->boardsize
+		&& other->routine == entry->routine
+		&& other->apos == entry->apos
+		&& other->bpos == entry->bpos
+		&& other->cpos == entry->cpos
+		&& other->color == entry->color
+		&& (goal_hash == NULL
+		    || hashdata_is_equal(other->goal_hash, *goal_hash)));
+    for (r = 0; same && r < MAX_CACHE_DEPTH; r++)
+      same = (other->stack[r] == entry->stack[r]
+	      && other->move_color[r] == entry->move_color[r]);
+    for (i = 0; same && i < entry->boardsize; i++)
+      for (j = 0; same && j < entry->boardsize; j++)
+	same = (other->board[POS(i, j)] == entry->board[POS(i, j)]);
+    if (same)
+      return 1;
+  }
+
+  return 0;
+}
+
+/* Go through the entries in data, written by export_persistent_caches().
+ * With add set the entries are added to the caches. Entries which
+ * don't fit are dropped, unless merge is set. Then a full cache gives
+ * up its lowest scoring entry for a new one with a higher score, as in
+ * store_persistent_cache(), and entries the cache already holds are
+ * skipped. Return the number of entries added, or -1 if the data is
+ * malformed.
+ */
+static int
+read_persistent_caches(const char *data, int length, int add, int merge)
+{
+  char header[64];
+  const unsigned char *p;
+  const unsigned char *end;
+  struct persistent_cache_entry entry;
+  int num_entries = 0;
+  int c, k;
+
+  write_cache_header(header);
+  if (length < (int) strlen(header)
+      || memcmp(data, header, strlen(header)) != 0)
+    return -1;
+
+  p = (const unsigned char *) data + strlen(header);
+  end = (const unsigned char *) data + length;
+  for (c = 0; c < NUM_CACHES; c++) {
+    struct persistent_cache *cache = all_caches[c];
+    int count;
+    if (end - p < 4)
+      return -1;
+    count = read_cache_int(p);
+    p += 4;
+    for (k = 0; k < count; k++) {
+      p = read_cache_entry(p, end, &entry);
+      if (p == NULL)
+	return -1;
+      if (!add)
+	continue;
+      entry.bucket = persistent_cache_bucket(cache, entry.routine,
+					     entry.apos, entry.bpos,
+					     entry.cpos, entry.color,
+					     stored_goal_hash(cache, &entry));
+      if (merge && known_persistent_cache_entry(cache, &entry))
+	continue;
+      if (cache->current_size == cache->max_size) {
+	int worst_entry = -1;
+	int worst_score = entry.score;
+	int i;
+	if (!merge)
+	  continue;
+	for (i = 0; i < cache->current_size; i++) {
+	  if (cache->table[i].score < worst_score) {
+	    worst_score = cache->table[i].score;
+	    worst_entry = i;
+	  }
+	}
+	if (worst_entry == -1)
+	  continue;
+	remove_persistent_cache_entry(cache, worst_entry);
+      }
+      cache->table[cache->current_size] = entry;
+      link_persistent_cache_entry(cache, cache->current_size);
+      cache->current_size++;
+      num_entries++;
+    }
+  }
+
+  if (p != end)
+    return -1;
+
+  return num_entries;
+}
+
+/* Replace the contents of the persistent caches with the entries in
+ * data, written by export_persistent_caches(). Entries which don't
+ * fit into a cache are dropped. Return the number of entries restored,
+ * or -1 if the data is malformed, in which case the caches are left
+ * empty.
+ */
+int
+import_persistent_caches(const char *data, int length)
+{
+  char header[64];
+  int num_entries;
+
+  write_cache_header(header);
+  if (length < (int) strlen(header)
+      || memcmp(data, header, strlen(header)) != 0)
+    return -1;
+
+  persistent_cache_init();
+  num_entries = read_persistent_caches(data, length, 1, 0);
+  if (num_entries < 0)
+    clear_persistent_caches();
+
+  return num_entries;
+}
+
+/* Add the entries in data, written by export_persistent_caches(), to
+ * the persistent caches, keeping the entries already there. This is
+ * used to collect the results read in worker processes, see
+ * analyze_in_processes(). Return the number of entries added, or -1
+ * if the data is malformed, in which case the caches are unchanged.
+ */
+int
+merge_persistent_caches(const char *data, int length)
+{
+  if (read_persistent_caches(data, length, 0, 0) < 0)
+    return -1;
+  return read_persistent_caches(data, length, 1, 1);
+}
+
+
 /* ================================================================ */
 /*                  Tactical reading functions                      */
 /* ================================================================ */
@@ -29,6 +29,12 @@
 #include <stdarg.h>
 #include <math.h>
 
+#if HAVE_FORK
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
 #include "liberty.h"
 #include "sgftree.h"
 #include "random.h"
@@ -2010,6 +2016,216 @@ list_mc_patterns(void)
   printf("Use \"--mc-load-patterns filename\" to directly load a pattern database.\n");
 }
 
+#if HAVE_FORK
+
+/* Upper limit for the number of worker processes. */
+#define MAX_ANALYZE_JOBS 64
+
+static int
+write_all(int fd, const void *buffer, int size)
+{
+  const char *p = buffer;
+  while (size > 0) {
+    int n = write(fd, p, size);
+    if (n <= 0)
+      return 0;
+    p += n;
+    size -= n;
+  }
+  return 1;
+}
+
+static int
+read_all(int fd, void *buffer, int size)
+{
+  char *p = buffer;
+  while (size > 0) {
+    int n = read(fd, p, size);
+    if (n <= 0)
+      return 0;
+    p += n;
+    size -= n;
+  }
+  return 1;
+}
+
+#endif
+
+/*
+ * analyze_in_processes() calls analyze() for each of the num_origins
+ * board points in origins[]. With jobs > 1 the points are split
+ * between that many forked processes, the k:th point going to process
+ * k % jobs so that the split doesn't depend on timing. After each
+ * call a process uses export_result() to store the result_size bytes
+ * of data computed for the point and sends them back.
+ *
+ * Once all processes are done, the results are handed to
+ * import_result() in the order of origins[], exactly where the serial
+ * loop would have computed them. Points for which nothing came back,
+ * e.g. because the process failed an assertion, are analyzed here in
+ * their place instead.
+ *
+ * Each process works on its own copy of the board, the reading stack
+ * and the caches. When it is done, it sends back its persistent
+ * caches, which are merged into those of the main process in process
+ * order. The cache for read results is not sent back, so later
+ * queries in the main process may have to redo some of the reading.
+ * With shared_reading_cache set, that cache is instead shared by all
+ * the processes. They then benefit from each other's reading, but the
+ * results may depend on the timing.
+ *
+ * Since a process doesn't see what the others read, and the caches of
+ * the main process end up with different contents, the results are
+ * not guaranteed to be the same as with jobs == 1. Without
+ * shared_reading_cache they are reproducible, though: they only
+ * depend on the position, the points and the number of processes.
+ */
+
+void
+analyze_in_processes(int jobs, const int *origins, int num_origins,
+		     void (*analyze)(int pos), int result_size,
+		     void (*export_result)(int pos, void *result),
+		     void (*import_result)(int pos, const void *result))
+{
+#if HAVE_FORK
+  int fds[MAX_ANALYZE_JOBS];
+  pid_t pids[MAX_ANALYZE_JOBS];
+  char *results;
+  char *message;
+  signed char *received;
+  char *caches[MAX_ANALYZE_JOBS];
+  int cache_sizes[MAX_ANALYZE_JOBS];
+  int message_size = sizeof(int) + result_size;
+  int j;
+#endif
+  int k;
+
+  gg_assert(stackp == 0);
+
+#if HAVE_FORK
+  jobs = gg_min(gg_min(jobs, MAX_ANALYZE_JOBS), num_origins);
+  if (jobs > 1) {
+    results = malloc(num_origins * result_size + message_size);
+    received = calloc(num_origins, 1);
+    if (results == NULL || received == NULL) {
+      free(results);
+      free(received);
+      jobs = 1;
+    }
+  }
+
+  if (jobs > 1) {
+    message = results + num_origins * result_size;
+    if (shared_reading_cache)
+      reading_cache_share();
+    fflush(stdout);
+    fflush(stderr);
+
+    for (j = 0; j < jobs; j++) {
+      int pipe_fds[2];
+
+      fds[j] = -1;
+      pids[j] = -1;
+      if (pipe(pipe_fds) != 0)
+	continue;
+
+      pids[j] = fork();
+      if (pids[j] == 0) {
+	close(pipe_fds[0]);
+	for (k = j; k < num_origins; k += jobs) {
+	  analyze(origins[k]);
+	  memset(message, 0, message_size);
+	  memcpy(message, &k, sizeof(int));
+	  export_result(origins[k], message + sizeof(int));
+	  if (!write_all(pipe_fds[1], message, message_size))
+	    _exit(0);
+	}
+
+	/* Finally the persistent caches, as a message with index -1
+	 * followed by their size and data.
+	 */
+	cache_sizes[j] = export_persistent_caches(NULL, 0);
+	caches[j] = malloc(cache_sizes[j]);
+	if (caches[j] != NULL) {
+	  export_persistent_caches(caches[j], cache_sizes[j]);
+	  k = -1;
+	  memset(message, 0, message_size);
+	  memcpy(message, &k, sizeof(int));
+	  if (write_all(pipe_fds[1], message, message_size)
+	      && write_all(pipe_fds[1], &cache_sizes[j], sizeof(int)))
+	    write_all(pipe_fds[1], caches[j], cache_sizes[j]);
+	}
+	_exit(0);
+      }
+
+      close(pipe_fds[1]);
+      if (pids[j] < 0)
+	close(pipe_fds[0]);
+      else
+	fds[j] = pipe_fds[0];
+    }
+
+    for (j = 0; j < jobs; j++) {
+      int status;
+
+      caches[j] = NULL;
+      if (fds[j] < 0)
+	continue;
+      while (read_all(fds[j], message, message_size)) {
+	int index;
+	memcpy(&index, message, sizeof(int));
+	if (index >= 0 && index < num_origins && index % jobs == j) {
+	  memcpy(results + index * result_size, message + sizeof(int),
+		 result_size);
+	  received[index] = 1;
+	}
+	else if (index == -1) {
+	  /* The caches come last. */
+	  if (read_all(fds[j], &cache_sizes[j], sizeof(int))
+	      && cache_sizes[j] > 0)
+	    caches[j] = malloc(cache_sizes[j]);
+	  if (caches[j] != NULL
+	      && !read_all(fds[j], caches[j], cache_sizes[j])) {
+	    free(caches[j]);
+	    caches[j] = NULL;
+	  }
+	  break;
+	}
+      }
+      close(fds[j]);
+      waitpid(pids[j], &status, 0);
+    }
+
+    for (j = 0; j < jobs; j++) {
+      if (caches[j] != NULL) {
+	merge_persistent_caches(caches[j], cache_sizes[j]);
+	free(caches[j]);
+      }
+    }
+
+    for (k = 0; k < num_origins; k++) {
+      if (received[k])
+	import_result(origins[k], results + k * result_size);
+      else
+	analyze(origins[k]);
+    }
+
+    free(results);
+    free(received);
+    return;
+  }
+#else
+  UNUSED(jobs);
+  UNUSED(result_size);
+  UNUSED(export_result);
+  UNUSED(import_result);
+#endif
+
+  for (k = 0; k < num_origins; k++)
+    analyze(origins[k]);
+}
+
+
 /*
  * Local Variables:
  * tab-width: 8
@@ -37,6 +37,7 @@ static void do_compute_effective_worm_sizes(int color,
 static void compute_unconditional_status(void);
 static void find_worm_attacks_and_defenses(void);
 static void find_worm_threats(void);
+static void for_each_worm_origin(void (*analyze)(int str));
 static int find_lunch(int str, int *lunch);
 static void change_tactical_point(int str, int move, int code,
 				  int points[MAX_TACTICAL_POINTS],
@@ -726,45 +727,171 @@ compute_unconditional_status()
   gg_assert(stackp == 0);
 }
 
-/*
- * Analyze tactical safety of each worm. 
+/* Copy the worm data of the worm at pos out of and back into a worker
+ * process, see analyze_in_processes().
  */
+static void
+export_worm(int pos, void *result)
+{
+  memcpy(result, &worm[pos], sizeof(struct worm_data));
+}
 
 static void
-find_worm_attacks_and_defenses()
+import_worm(int pos, const void *result)
+{
+  memcpy(&worm[pos], result, sizeof(struct worm_data));
+  propagate_worm(pos);
+}
+
+/* Call analyze() for the origin of every worm, in board order or,
+ * with worm_jobs > 1, spread over several processes.
+ */
+static void
+for_each_worm_origin(void (*analyze)(int str))
 {
+  int origins[BOARDMAX];
+  int num_origins = 0;
   int str;
+
+  for (str = BOARDMIN; str < BOARDMAX; str++)
+    if (IS_STONE(board[str]) && is_worm_origin(str, str))
+      origins[num_origins++] = str;
+
+  analyze_in_processes(worm_jobs, origins, num_origins, analyze,
+		       sizeof(struct worm_data), export_worm, import_worm);
+}
+
+/* Find an attack point for the worm at str. */
+static void
+worm_attack(int str)
+{
   int k;
-  int acode, dcode;
+  int acode;
+  int attack_point;
+
+  TRACE("considering attack of %1m\n", str);
+  /* Initialize all relevant fields at once. */
+  for (k = 0; k < MAX_TACTICAL_POINTS; k++) {
+    worm[str].attack_codes[k]   = 0;
+    worm[str].attack_points[k]  = 0;
+    worm[str].defense_codes[k]  = 0;
+    worm[str].defense_points[k] = 0;
+  }
+  propagate_worm(str);
+  
+  acode = attack(str, &attack_point);
+  if (acode != 0) {
+    DEBUG(DEBUG_WORMS, "worm at %1m can be attacked at %1m\n",
+	  str, attack_point);
+    change_attack(str, attack_point, acode);
+  }
+}
+
+/* Find a defense point for the worm at str, if it can be attacked. */
+static void
+worm_defense(int str)
+{
+  int dcode;
   int attack_point;
   int defense_point;
-  static int libs[MAXLIBS];
-  int liberties;
-  int color;
-  int other;
 
-   /* 1. Start with finding attack points. */
-  for (str = BOARDMIN; str < BOARDMAX; str++) {
-    if (!IS_STONE(board[str]) || !is_worm_origin(str, str))
-      continue;
+  if (worm[str].attack_codes[0] == 0)
+    return;
+
+  TRACE("considering defense of %1m\n", str);
+  dcode = find_defense(str, &defense_point);
+  if (dcode != 0) {
+    TRACE("worm at %1m can be defended at %1m\n", str, defense_point);
+    if (defense_point != NO_MOVE)
+      change_defense(str, defense_point, dcode);
+  }
+  else {
+    /* If the point of attack is not adjacent to the worm, 
+     * it is possible that this is an overlooked point of
+     * defense, so we try and see if it defends.
+     */
+    attack_point = worm[str].attack_points[0];
+    if (!liberty_of_string(attack_point, str))
+      if (trymove(attack_point, worm[str].color, "make_worms", NO_MOVE)) {
+	int acode = attack(str, NULL);
+	if (acode != WIN) {
+	  change_defense(str, attack_point, REVERSE_RESULT(acode));
+	  TRACE("worm at %1m can be defended at %1m with code %d\n",
+		str, attack_point, REVERSE_RESULT(acode));
+	}	 
+	popgo();
+      }
+  }
+}
 
-    TRACE("considering attack of %1m\n", str);
-    /* Initialize all relevant fields at once. */
-    for (k = 0; k < MAX_TACTICAL_POINTS; k++) {
-      worm[str].attack_codes[k]   = 0;
-      worm[str].attack_points[k]  = 0;
-      worm[str].defense_codes[k]  = 0;
-      worm[str].defense_points[k] = 0;
+/* Find additional attacks and defenses of the worm at str by testing
+ * all its immediate liberties.
+ */
+static void
+worm_liberty_moves(int str)
+{
+  int k;
+  int acode, dcode;
+  int libs[MAXLIBS];
+  int liberties;
+  int color = board[str];
+  int other = OTHER_COLOR(color);
+  
+  if (worm[str].attack_codes[0] == 0)
+    return;
+  
+  /* There is at least one attack on this group. Try the
+   * liberties.
+   */
+  liberties = findlib(str, MAXLIBS, libs);
+  
+  for (k = 0; k < liberties; k++) {
+    int pos = libs[k];
+    if (!attack_move_known(pos, str)) {
+      /* Try to attack on the liberty. Don't consider
+       * send-two-return-one moves.
+       */
+      if (!send_two_return_one(pos, other)
+	  && trymove(pos, other, "make_worms", str)) {
+	if (board[str] == EMPTY || attack(str, NULL)) {
+	  if (board[str] == EMPTY)
+	    dcode = 0;
+	  else
+	    dcode = find_defense(str, NULL);
+	  
+	  if (dcode != WIN)
+	    change_attack(str, pos, REVERSE_RESULT(dcode));
+	}
+	popgo();
+      }
     }
-    propagate_worm(str);
-    
-    acode = attack(str, &attack_point);
-    if (acode != 0) {
-      DEBUG(DEBUG_WORMS, "worm at %1m can be attacked at %1m\n",
-	    str, attack_point);
-      change_attack(str, attack_point, acode);
+    /* Try to defend at the liberty. */
+    if (!defense_move_known(pos, str)) {
+      if (worm[str].defense_codes[0] != 0)
+	if (trymove(pos, color, "make_worms", NO_MOVE)) {
+	  acode = attack(str, NULL);
+	  if (acode != WIN)
+	    change_defense(str, pos, REVERSE_RESULT(acode));
+	  popgo();
+	}
     }
   }
+}
+
+/*
+ * Analyze tactical safety of each worm. 
+ *
+ * The tactical reading of one worm doesn't depend on the results for
+ * the others, so the reading steps are done by for_each_worm_origin()
+ * which may spread them over several processes. The pattern matching
+ * looks at all worms at once and stays in this process.
+ */
+
+static void
+find_worm_attacks_and_defenses()
+{
+  /* 1. Start with finding attack points. */
+  for_each_worm_origin(worm_attack);
   gg_assert(stackp == 0);
   
   /* 2. Use pattern matching to find a few more attacks. */
@@ -772,38 +899,7 @@ find_worm_attacks_and_defenses()
   gg_assert(stackp == 0);
   
   /* 3. Now find defense moves. */
-  for (str = BOARDMIN; str < BOARDMAX; str++) {
-    if (!IS_STONE(board[str]) || !is_worm_origin(str, str))
-      continue;
-
-    if (worm[str].attack_codes[0] != 0) {
-
-      TRACE("considering defense of %1m\n", str);
-      dcode = find_defense(str, &defense_point);
-      if (dcode != 0) {
-	TRACE("worm at %1m can be defended at %1m\n", str, defense_point);
-	if (defense_point != NO_MOVE)
-	  change_defense(str, defense_point, dcode);
-      }
-      else {
-	/* If the point of attack is not adjacent to the worm, 
-	 * it is possible that this is an overlooked point of
-	 * defense, so we try and see if it defends.
-	 */
-	attack_point = worm[str].attack_points[0];
-	if (!liberty_of_string(attack_point, str))
-	  if (trymove(attack_point, worm[str].color, "make_worms", NO_MOVE)) {
-	    int acode = attack(str, NULL);
-	    if (acode != WIN) {
-	      change_defense(str, attack_point, REVERSE_RESULT(acode));
-	      TRACE("worm at %1m can be defended at %1m with code %d\n",
-		    str, attack_point, REVERSE_RESULT(acode));
-	    }	 
-	    popgo();
-	  }
-      }
-    }
-  }
+  for_each_worm_origin(worm_defense);
   gg_assert(stackp == 0);
 
   /* 4. Use pattern matching to find a few more defense moves. */
@@ -816,165 +912,123 @@ find_worm_attacks_and_defenses()
    *    matching and by trying whether each attack or defense point
    *    attacks or defends other strings.
    */
-  for (str = BOARDMIN; str < BOARDMAX; str++) {
-    color = board[str];
-    if (!IS_STONE(color) || !is_worm_origin(str, str))
-      continue;
-    
-    other = OTHER_COLOR(color);
-    
-    if (worm[str].attack_codes[0] == 0)
-      continue;
-    
-    /* There is at least one attack on this group. Try the
-     * liberties.
-     */
-    liberties = findlib(str, MAXLIBS, libs);
-    
-    for (k = 0; k < liberties; k++) {
-      int pos = libs[k];
-      if (!attack_move_known(pos, str)) {
-	/* Try to attack on the liberty. Don't consider
-	 * send-two-return-one moves.
-	 */
-	if (!send_two_return_one(pos, other)
-	    && trymove(pos, other, "make_worms", str)) {
-	  if (board[str] == EMPTY || attack(str, NULL)) {
-	    if (board[str] == EMPTY)
-	      dcode = 0;
-	    else
-	      dcode = find_defense(str, NULL);
-	    
-	    if (dcode != WIN)
-	      change_attack(str, pos, REVERSE_RESULT(dcode));
-	  }
-	  popgo();
-	}
-      }
-      /* Try to defend at the liberty. */
-      if (!defense_move_known(pos, str)) {
-	if (worm[str].defense_codes[0] != 0)
-	  if (trymove(pos, color, "make_worms", NO_MOVE)) {
-	    acode = attack(str, NULL);
-	    if (acode != WIN)
-	      change_defense(str, pos, REVERSE_RESULT(acode));
-	    popgo();
-	  }
-      }
-    }
-  }
+  for_each_worm_origin(worm_liberty_moves);
   gg_assert(stackp == 0);
 }
 
 
 /*
- * Find moves threatening to attack or save all worms.
+ * Find moves threatening to attack or save the worm at str.
  */
 
 static void
-find_worm_threats()
+worm_threats(int str)
 {
-  int str;
-  static int libs[MAXLIBS];
+  int libs[MAXLIBS];
   int liberties;
   
   int k;
   int l;
-  int color;
+  int color = board[str];
   
-  for (str = BOARDMIN; str < BOARDMAX; str++) {
-    color = board[str];
-    if (!IS_STONE(color) || !is_worm_origin(str, str))
-      continue;
-
-    /* 1. Start with finding attack threats. */
-    /* Only try those worms that have no attack. */
-    if (worm[str].attack_codes[0] == 0) {
-      attack_threats(str, MAX_TACTICAL_POINTS,
-		     worm[str].attack_threat_points,
-		     worm[str].attack_threat_codes);
+  /* 1. Start with finding attack threats. */
+  /* Only try those worms that have no attack. */
+  if (worm[str].attack_codes[0] == 0) {
+    attack_threats(str, MAX_TACTICAL_POINTS,
+		   worm[str].attack_threat_points,
+		   worm[str].attack_threat_codes);
 #if 0
-      /* Threaten to attack by saving weak neighbors. */
-      num_adj = chainlinks(str, adjs);
-      for (k = 0; k < num_adj; k++) {
-	if (worm[adjs[k]].attack_codes[0] != 0
-	    && worm[adjs[k]].defense_codes[0] != 0)
-	  for (r = 0; r < MAX_TACTICAL_POINTS; r++) {
-	    int bb;
-	    
-	    if (worm[adjs[k]].defense_codes[r] == 0)
-	      break;
-	    bb = worm[adjs[k]].defense_points[r];
-	    if (trymove(bb, other, "threaten attack", str,
-			EMPTY, NO_MOVE)) {
-	      int acode;
-	      if (board[str] == EMPTY)
-		acode = WIN;
-	      else
-		acode = attack(str, NULL);
-	      if (acode != 0)
-		change_attack_threat(str, bb, acode);
-	      popgo();
-	    }
+    /* Threaten to attack by saving weak neighbors. */
+    num_adj = chainlinks(str, adjs);
+    for (k = 0; k < num_adj; k++) {
+      if (worm[adjs[k]].attack_codes[0] != 0
+	  && worm[adjs[k]].defense_codes[0] != 0)
+	for (r = 0; r < MAX_TACTICAL_POINTS; r++) {
+	  int bb;
+	  
+	  if (worm[adjs[k]].defense_codes[r] == 0)
+	    break;
+	  bb = worm[adjs[k]].defense_points[r];
+	  if (trymove(bb, other, "threaten attack", str,
+		      EMPTY, NO_MOVE)) {
+	    int acode;
+	    if (board[str] == EMPTY)
+	      acode = WIN;
+	    else
+	      acode = attack(str, NULL);
+	    if (acode != 0)
+	      change_attack_threat(str, bb, acode);
+	    popgo();
 	  }
-      }
-#endif
-      /* FIXME: Try other moves also (patterns?). */
+	}
     }
+#endif
+    /* FIXME: Try other moves also (patterns?). */
+  }
+  
+  /* 2. Continue with finding defense threats. */
+  /* Only try those worms that have an attack. */
+  if (worm[str].attack_codes[0] != 0
+      && worm[str].defense_codes[0] == 0) {
     
-    /* 2. Continue with finding defense threats. */
-    /* Only try those worms that have an attack. */
-    if (worm[str].attack_codes[0] != 0
-	&& worm[str].defense_codes[0] == 0) {
+    liberties = findlib(str, MAXLIBS, libs);
+    
+    for (k = 0; k < liberties; k++) {
+      int aa = libs[k];
       
-      liberties = findlib(str, MAXLIBS, libs);
+      /* Try to threaten on the liberty. */
+      if (trymove(aa, color, "threaten defense", NO_MOVE)) {
+	if (attack(str, NULL) == WIN) {
+	  int dcode = find_defense(str, NULL);
+	  if (dcode != 0)
+	    change_defense_threat(str, aa, dcode);
+	}
+	popgo();
+      }
       
-      for (k = 0; k < liberties; k++) {
-	int aa = libs[k];
+      /* Try to threaten on second order liberties. */
+      for (l = 0; l < 4; l++) {
+	int bb = libs[k] + delta[l];
+	
+	if (!ON_BOARD(bb)
+	    || IS_STONE(board[bb])
+	    || liberty_of_string(bb, str))
+	  continue;
 	
-	/* Try to threaten on the liberty. */
-	if (trymove(aa, color, "threaten defense", NO_MOVE)) {
+	if (trymove(bb, color, "threaten defense", str)) {
 	  if (attack(str, NULL) == WIN) {
 	    int dcode = find_defense(str, NULL);
 	    if (dcode != 0)
-	      change_defense_threat(str, aa, dcode);
+	      change_defense_threat(str, bb, dcode);
 	  }
 	  popgo();
 	}
-	
-	/* Try to threaten on second order liberties. */
-	for (l = 0; l < 4; l++) {
-	  int bb = libs[k] + delta[l];
-	  
-	  if (!ON_BOARD(bb)
-	      || IS_STONE(board[bb])
-	      || liberty_of_string(bb, str))
-	    continue;
-	  
-	  if (trymove(bb, color, "threaten defense", str)) {
-	    if (attack(str, NULL) == WIN) {
-	      int dcode = find_defense(str, NULL);
-	      if (dcode != 0)
-		change_defense_threat(str, bb, dcode);
-	    }
-	    popgo();
-	  }
-	}
       }
-      
-      /* It might be interesting to look for defense threats by
-       * attacking weak neighbors, similar to threatening attack by
-       * defending a weak neighbor. However, in this case it seems
-       * probable that if there is such an attack, it's a real
-       * defense, not only a threat. 
-       */
-      
-      /* FIXME: Try other moves also (patterns?). */
     }
+    
+    /* It might be interesting to look for defense threats by
+     * attacking weak neighbors, similar to threatening attack by
+     * defending a weak neighbor. However, in this case it seems
+     * probable that if there is such an attack, it's a real
+     * defense, not only a threat. 
+     */
+    
+    /* FIXME: Try other moves also (patterns?). */
   }
 }
 
 
+/*
+ * Find moves threatening to attack or save all worms.
+ */
+
+static void
+find_worm_threats()
+{
+  for_each_worm_origin(worm_threats);
+}
+
+
 /* find_lunch(str, &worm) looks for a worm adjoining the
  * string at (str) which can be easily captured. Whether or not it can
  * be defended doesn't matter.
@@ -44,6 +44,21 @@ void load_and_analyze_sgf_file(Gameinfo *gameinfo);
 float load_and_score_sgf_file(SGFTree *tree, Gameinfo *gameinfo,
 			     const char *scoringmode);
 
+/* Engine session kept between calls, see main.c. */
+void new_session(int seed);
+char *session_play(char *board);
+float session_score(char *board);
+char *analyze(char *board, int top_n);
+int session_has_game(void);
+
+/* Batch processing of a stream of games, see play_stream.c. */
+#define STREAM_PLAY    0
+#define STREAM_SCORE   1
+#define STREAM_ANALYZE 2
+
+void play_stream(FILE *input, FILE *output, int mode, int jsonl, int jobs,
+		 int seed);
+
 
 #endif
 
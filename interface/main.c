@@ -27,6 +27,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdarg.h>
+#include <limits.h>
 
 #ifdef HAVE_UNISTD_H
 /* For isatty(). */
@@ -159,6 +161,8 @@ enum {OPT_BOARDSIZE = 127,
       OPT_NEVER_RESIGN,
       OPT_MONTE_CARLO,
       OPT_MC_GAMES_PER_LEVEL,
+      OPT_MC_THREADS,
+      OPT_MC_REUSE_TREE,
       OPT_MC_PATTERNS,
       OPT_MC_LIST_PATTERNS,
       OPT_MC_LOAD_PATTERNS
@@ -309,6 +313,8 @@ static struct gg_option const long_options[] =
   {"never-resign",   no_argument,       0, OPT_NEVER_RESIGN},
   {"monte-carlo",    no_argument,       0, OPT_MONTE_CARLO},
   {"mc-games-per-level", required_argument, 0, OPT_MC_GAMES_PER_LEVEL},
+  {"mc-threads",     required_argument, 0, OPT_MC_THREADS},
+  {"mc-reuse-tree",  no_argument,       0, OPT_MC_REUSE_TREE},
   {"mc-patterns",    required_argument, 0, OPT_MC_PATTERNS},
   {"mc-list-patterns", no_argument,     0, OPT_MC_LIST_PATTERNS},
   {"mc-load-patterns", required_argument, 0, OPT_MC_LOAD_PATTERNS},
@@ -316,11 +322,98 @@ static struct gg_option const long_options[] =
 };
 
 char *play(int seed, char *board);
+
+#define BATCH_USAGE "\
+usage: %s sgf-file-content\n\
+       %s --batch [options] [file]\n\
+\n\
+Batch options:\n\
+   -j, --jobs <n>    Number of worker processes (default 1)\n\
+       --jsonl       Read and write JSON lines instead of one sgf per line\n\
+       --score       Score the games instead of generating a move\n\
+       --analyze     Write the analysis JSON instead of the game record\n\
+       --seed <n>    Random seed for games without one (default 0)\n\
+       --owl-jobs <n>  Processes sharing the owl reading of each move\n\
+                       (default 1)\n\
+       --worm-jobs <n> Processes sharing the tactical reading of each\n\
+                       move (default 1)\n\
+       --shared-cache  Let those processes share the read result cache\n\
+       --keep-cache    Keep the read result cache between moves\n\
+       --monte-carlo   Use Monte Carlo move generation (9x9 or smaller)\n\
+       --mc-threads <n>  Threads sharing the Monte Carlo search of each\n\
+                       move (default 1)\n\
+       --mc-reuse-tree Start the Monte Carlo search from the previous one\n\
+"
+
+/* Batch mode: read one game per line from the file given or from
+ * stdin and write one result per line to stdout, see play_stream.c.
+ */
+static int
+batch_main(int argc, char *argv[])
+{
+  FILE *input = stdin;
+  int mode = STREAM_PLAY;
+  int jsonl = 0;
+  int jobs = 1;
+  int seed = 0;
+  int k;
+
+  for (k = 2; k < argc; k++) {
+    if ((strcmp(argv[k], "-j") == 0 || strcmp(argv[k], "--jobs") == 0)
+	&& k + 1 < argc)
+      jobs = atoi(argv[++k]);
+    else if (strcmp(argv[k], "--seed") == 0 && k + 1 < argc)
+      seed = atoi(argv[++k]);
+    else if (strcmp(argv[k], "--owl-jobs") == 0 && k + 1 < argc)
+      owl_jobs = atoi(argv[++k]);
+    else if (strcmp(argv[k], "--worm-jobs") == 0 && k + 1 < argc)
+      worm_jobs = atoi(argv[++k]);
+    else if (strcmp(argv[k], "--shared-cache") == 0)
+      shared_reading_cache = 1;
+    else if (strcmp(argv[k], "--keep-cache") == 0)
+      reuse_reading_cache = 1;
+    else if (strcmp(argv[k], "--monte-carlo") == 0)
+      use_monte_carlo_genmove = 1;
+    else if (strcmp(argv[k], "--mc-threads") == 0 && k + 1 < argc)
+      mc_threads = atoi(argv[++k]);
+    else if (strcmp(argv[k], "--mc-reuse-tree") == 0)
+      mc_reuse_tree = 1;
+    else if (strcmp(argv[k], "--jsonl") == 0)
+      jsonl = 1;
+    else if (strcmp(argv[k], "--score") == 0)
+      mode = STREAM_SCORE;
+    else if (strcmp(argv[k], "--analyze") == 0)
+      mode = STREAM_ANALYZE;
+    else if (argv[k][0] == '-' && argv[k][1] != '\0') {
+      fprintf(stderr, BATCH_USAGE, argv[0], argv[0]);
+      return 1;
+    }
+    else if (strcmp(argv[k], "-") != 0) {
+      input = fopen(argv[k], "r");
+      if (input == NULL) {
+	fprintf(stderr, "gnugo: cannot open %s\n", argv[k]);
+	return 1;
+      }
+    }
+  }
+
+  if (jobs < 1)
+    jobs = 1;
+
+  play_stream(input, stdout, mode, jsonl, jobs, seed);
+  if (input != stdin)
+    fclose(input);
+  return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
+  if (argc >= 2 && strcmp(argv[1], "--batch") == 0)
+    return batch_main(argc, argv);
+
   if (argc != 2) {
-    printf("usage: %s sgf-file-content\n", argv[0]);
+    printf(BATCH_USAGE, argv[0], argv[0]);
     return 1;
   } else {
     printf("%s\n", play(0, argv[1]));
@@ -439,6 +532,8 @@ Experimental options:\n\
    --mirror-limit <n>      stop mirroring when n stones on board\n\n\
    --monte-carlo           enable Monte Carlo move generation (9x9 or smaller)\n\
    --mc-games-per-level <n> number of Monte Carlo simulations per level\n\
+   --mc-threads <n>        number of threads for the Monte Carlo search\n\
+   --mc-reuse-tree         keep the Monte Carlo search tree between moves\n\
    --mc-list-patterns      list names of builtin Monte Carlo patterns\n\
    --mc-patterns <name>    choose a built in Monte Carlo pattern database\n\
    --mc-load-patterns <filename> read Monte Carlo patterns from file\n\
@@ -836,11 +931,59 @@ socket_stop_listening(FILE *input_file, FILE *output_file)
 
 
 // wasm interfaces
+
+/* Size of the transposition table in megabytes. Non-positive means the
+ * default number of cache entries.
+ */
+static float cache_memory = DEFAULT_MEMORY;
+
+/* Set once new_session() has initialized the engine, see below. */
+static int session_active = 0;
+
 char *get_version(void)
 {
   return VERSION;
 }
 
+/* Run the deterministic part of the engine initialization. Snapshot
+ * tools call this at build time, so that the tables are already part
+ * of the memory image and the first play() skips their setup.
+ */
+void init_tables(void)
+{
+  init_gnugo_tables();
+}
+
+/* Set the memory budget of the transposition table. The table of a
+ * running session is resized right away, otherwise the size is used
+ * by the next initialization. The size in bytes is passed on as an
+ * int, so the budget is limited to just under 2 GB.
+ */
+void set_cache_size(float megabytes)
+{
+  if (megabytes > INT_MAX / (1024 * 1024))
+    megabytes = INT_MAX / (1024 * 1024);
+  cache_memory = megabytes;
+  if (session_active)
+    reading_cache_init(cache_memory * 1024 * 1024);
+}
+
+/* Return 1 if the fuseki database for this board size was left out of
+ * the build (--enable-lazy-fuseki) and still has to be loaded.
+ */
+int need_fuseki(int boardsize)
+{
+  return need_fuseki_database(boardsize);
+}
+
+/* Load a fuseki database written by "uncompress_fuseki <size> <file>
+ * bin". Return its board size, or 0 if the data is not a database.
+ */
+int load_fuseki(char *data, int length)
+{
+  return load_fuseki_database(data, length);
+}
+
 char *play(int seed, char *board)
 {
   Gameinfo gameinfo;
@@ -849,7 +992,7 @@ char *play(int seed, char *board)
   sgftree_clear(&sgftree);
   gameinfo_clear(&gameinfo);
 
-  init_gnugo(DEFAULT_MEMORY, seed);
+  init_gnugo(cache_memory, seed);
 
   // We cheat fileread by providing the raw file content
   setsgffile(board);
@@ -878,7 +1021,7 @@ float score(int seed, char *board)
   sgftree_clear(&sgftree);
   gameinfo_clear(&gameinfo);
 
-  init_gnugo(DEFAULT_MEMORY, seed);
+  init_gnugo(cache_memory, seed);
 
   // We cheat fileread by providing the raw file content
   setsgffile(board);
@@ -897,3 +1040,606 @@ float score(int seed, char *board)
   set_in_memory_content();
   return load_and_score_sgf_file(&sgftree, &gameinfo, "");
 }
+
+
+/* Engine session for the wasm build.
+ *
+ * play() and score() above start every call with init_gnugo(), which
+ * clears the transposition table and the persistent caches and sets
+ * up the pattern matchers again. A session does this work once
+ * in new_session(); the session_* calls below then only update the
+ * position, so the tables stay allocated and the persistent caches
+ * stay warm from one call to the next.
+ *
+ * The session also keeps the game record of the last position. When
+ * session_play() or session_score() get a game continuing that
+ * position, only the new moves are played, and session_append() adds
+ * moves without resending the game at all.
+ *
+ * A session can hold several independent games, see
+ * session_new_game(). The current game is in session_gameinfo,
+ * session_tree and on the engine board, the others are parked in
+ * session_games[] with their board in a Gamecontext. All games share
+ * the pattern tables and caches of the session.
+ */
+
+static Gameinfo session_gameinfo;
+static SGFTree session_tree;
+
+struct session_game {
+  int in_use;
+  Gamecontext context;
+  Gameinfo gameinfo;
+  SGFTree tree;
+};
+
+static struct session_game *session_games = NULL;
+static int num_session_games = 0;
+static int current_game = 0;
+
+/* Parse the sgf content in board and bring the session position in
+ * line with it. Return 1 on success, 0 if the content could not be
+ * parsed or loaded. On failure the session drops its game, so that
+ * session_has_game() tells the caller the result is not valid.
+ */
+static int
+session_load(char *board)
+{
+  SGFTree sgftree;
+
+  sgftree_clear(&sgftree);
+  setsgffile(board);
+  if (!sgftree_readfile(&sgftree, "-")) {
+    fprintf(stderr, "Cannot open or parse '%s'\n", board);
+    sgfFreeNode(session_tree.root);
+    sgftree_clear(&session_tree);
+    return 0;
+  }
+
+  if (gameinfo_sync_sgftree(&session_gameinfo, &sgftree) == EMPTY) {
+    fprintf(stderr, "Cannot load '%s'\n", board);
+    sgfFreeNode(sgftree.root);
+    sgfFreeNode(session_tree.root);
+    sgftree_clear(&session_tree);
+    return 0;
+  }
+
+  sgfFreeNode(session_tree.root);
+  session_tree = sgftree;
+  session_gameinfo.game_record = session_tree;
+  return 1;
+}
+
+/* Start the session, or restart it with a new random seed. Only the
+ * first call initializes the engine.
+ */
+void new_session(int seed)
+{
+  if (!session_active) {
+    init_gnugo(cache_memory, seed);
+    gameinfo_clear(&session_gameinfo);
+    sgftree_clear(&session_tree);
+    session_active = 1;
+  }
+  else
+    set_random_seed(seed);
+}
+
+/* Discard all cached reading results of the session, e.g. before
+ * switching to an unrelated game.
+ */
+void clear_session(void)
+{
+  if (!session_active)
+    return;
+  clear_persistent_caches();
+  reading_cache_clear();
+}
+
+/* Write the persistent caches of the session, i.e. the expensive
+ * local reading results, to data so that they can be restored in a
+ * later session with session_import_caches(). Return the number of
+ * bytes needed. Nothing is written if that is more than length.
+ */
+int session_export_caches(char *data, int length)
+{
+  if (!session_active)
+    new_session(0);
+  return export_persistent_caches(data, length);
+}
+
+/* Replace the persistent caches of the session with data written by
+ * session_export_caches(). Return the number of restored results, or
+ * -1 if the data was written by an incompatible build or is
+ * malformed.
+ */
+int session_import_caches(char *data, int length)
+{
+  if (!session_active)
+    new_session(0);
+  return import_persistent_caches(data, length);
+}
+
+/* Add an empty game to the session and return its id, or -1 if the
+ * memory is exhausted. The current game is not changed. The first
+ * game of the session has id 0.
+ */
+int session_new_game(void)
+{
+  int id;
+
+  if (!session_active)
+    new_session(0);
+
+  if (num_session_games == 0) {
+    session_games = calloc(1, sizeof(*session_games));
+    if (session_games == NULL)
+      return -1;
+    session_games[0].in_use = 1;
+    gamecontext_init(&session_games[0].context);
+    num_session_games = 1;
+  }
+
+  for (id = 0; id < num_session_games; id++)
+    if (!session_games[id].in_use)
+      break;
+
+  if (id == num_session_games) {
+    struct session_game *games = realloc(session_games,
+					 (num_session_games + 1)
+					 * sizeof(*session_games));
+    if (games == NULL)
+      return -1;
+    session_games = games;
+    num_session_games++;
+  }
+
+  session_games[id].in_use = 1;
+  gamecontext_init(&session_games[id].context);
+  gameinfo_clear(&session_games[id].gameinfo);
+  sgftree_clear(&session_games[id].tree);
+  return id;
+}
+
+/* Make game id the current game of the session, which all other
+ * session calls work on. Return 1 on success, 0 if there is no such
+ * game.
+ */
+int session_select_game(int id)
+{
+  struct session_game *game;
+
+  if (id == current_game)
+    return session_active;
+  if (id < 0 || id >= num_session_games || !session_games[id].in_use)
+    return 0;
+
+  game = &session_games[current_game];
+  gamecontext_save(&game->context);
+  game->gameinfo = session_gameinfo;
+  game->tree = session_tree;
+
+  game = &session_games[id];
+  gamecontext_restore(&game->context);
+  session_gameinfo = game->gameinfo;
+  session_tree = game->tree;
+  current_game = id;
+  return 1;
+}
+
+/* Remove a game from the session. The current game can't be removed.
+ * Return 1 on success, 0 otherwise.
+ */
+int session_delete_game(int id)
+{
+  struct session_game *game;
+
+  if (id == current_game || id < 0 || id >= num_session_games
+      || !session_games[id].in_use)
+    return 0;
+
+  game = &session_games[id];
+  gamecontext_free(&game->context);
+  sgfFreeNode(game->tree.root);
+  sgftree_clear(&game->tree);
+  game->in_use = 0;
+  return 1;
+}
+
+/* Return 1 if the session holds a game, 0 if there is none or the last
+ * one could not be loaded.
+ */
+int session_has_game(void)
+{
+  return session_active && session_tree.root != NULL;
+}
+
+/* Generate and play a move at the current session position. Return
+ * the updated game record.
+ */
+char *session_genmove(void)
+{
+  if (!session_active || session_tree.root == NULL)
+    return "";
+
+  outfilename[0] = '*';
+  set_in_memory_content();
+  load_and_analyze_sgf_file(&session_gameinfo);
+
+  /* The move is now on the board and in the game record. */
+  session_tree.lastnode = NULL;
+  session_gameinfo.game_record = session_tree;
+  session_gameinfo.to_move = OTHER_COLOR(session_gameinfo.to_move);
+  return get_sgf_content();
+}
+
+/* Play the moves in an sgf node sequence, e.g. ";B[ee];W[cc]", at
+ * the current session position. Return 1 if all moves were played, 0
+ * if there is no position or one of the moves is not allowed. In that
+ * case none of the moves is played.
+ */
+int session_append(char *moves)
+{
+  SGFTree sgftree;
+  SGFNode *node;
+  SGFProperty *prop;
+  char *content;
+  int played = 0;
+  int result = 1;
+
+  if (!session_active || session_tree.root == NULL)
+    return 0;
+
+  content = malloc(strlen(moves) + 3);
+  if (content == NULL)
+    return 0;
+  sprintf(content, "(%s)", moves);
+
+  sgftree_clear(&sgftree);
+  setsgffile(content);
+  if (!sgftree_readfile(&sgftree, "-")) {
+    fprintf(stderr, "Cannot parse moves '%s'\n", moves);
+    free(content);
+    return 0;
+  }
+
+  /* Play the moves, checking each one against the rules of the game. */
+  for (node = sgftree.root; node && result; node = node->child) {
+    for (prop = node->props; prop; prop = prop->next) {
+      int move;
+      int color;
+      if (prop->name != SGFB && prop->name != SGFW)
+	continue;
+
+      move = get_sgfmove(prop);
+      color = (prop->name == SGFW) ? WHITE : BLACK;
+      if (move != PASS_MOVE
+	  && (!ON_BOARD1(move) || !is_allowed_move(move, color))) {
+	fprintf(stderr, "Cannot play %s\n", prop->value);
+	result = 0;
+	break;
+      }
+      gnugo_play_move(move, color);
+      played++;
+    }
+  }
+
+  if (!result)
+    undo_move(played);
+  else {
+    /* All moves were played, add them to the game record. */
+    session_tree.lastnode = NULL;
+    for (node = sgftree.root; node; node = node->child) {
+      for (prop = node->props; prop; prop = prop->next) {
+	int move;
+	int color;
+	if (prop->name != SGFB && prop->name != SGFW)
+	  continue;
+
+	move = get_sgfmove(prop);
+	color = (prop->name == SGFW) ? WHITE : BLACK;
+	sgftreeAddPlay(&session_tree, color, I(move), J(move));
+	session_gameinfo.to_move = OTHER_COLOR(color);
+      }
+    }
+    session_gameinfo.game_record = session_tree;
+  }
+
+  sgfFreeNode(sgftree.root);
+  free(content);
+  return result;
+}
+
+/* Analysis result for the wasm api, formatted as JSON:
+ *
+ *   {"color":"black","move":"E5","value":25.01,
+ *    "white_score":-3.5,"black_score":-7.5,
+ *    "top":[["E5",25.01],["C5",21.30]],
+ *    "dragons":[{"origin":"C3","color":"white","stones":3,
+ *                "status":"alive"}]}
+ *
+ * The buffer is large enough for every point of the board to appear
+ * both in the move list and as a dragon.
+ */
+#define ANALYSIS_BUFSIZE (BOARDMAX * 128)
+
+static char analysis[ANALYSIS_BUFSIZE];
+static int analysis_length;
+
+static void
+analysis_printf(const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  gg_vsnprintf(analysis + analysis_length,
+	       ANALYSIS_BUFSIZE - analysis_length, fmt, ap);
+  va_end(ap);
+  analysis_length += strlen(analysis + analysis_length);
+}
+
+/* Generate a move at the current session position without playing
+ * it and return the analysis as JSON, with at most top_n of the
+ * considered moves, ordered by value.
+ */
+char *session_analyze(int top_n)
+{
+  static int moves[BOARDMAX];
+  int num_moves = 0;
+  int color;
+  int move;
+  float move_value;
+  char buf[8];
+  int pos;
+  int k;
+
+  if (!session_active || session_tree.root == NULL)
+    return "";
+
+  color = session_gameinfo.to_move;
+  move = genmove(color, &move_value, NULL);
+
+  /* Insertion sort of the considered moves. */
+  for (pos = BOARDMIN; pos < BOARDMAX; pos++) {
+    if (!ON_BOARD(pos) || potential_moves[pos] <= 0.0)
+      continue;
+    for (k = num_moves; k > 0; k--) {
+      if (potential_moves[moves[k-1]] >= potential_moves[pos])
+	break;
+      moves[k] = moves[k-1];
+    }
+    moves[k] = pos;
+    num_moves++;
+  }
+  if (top_n >= 0 && num_moves > top_n)
+    num_moves = top_n;
+
+  analysis_length = 0;
+  analysis[0] = '\0';
+  location_to_buffer(move, buf);
+  analysis_printf("{\"color\":\"%s\",\"move\":\"%s\",\"value\":%.2f,",
+		  color_to_string(color), buf, move_value);
+  analysis_printf("\"white_score\":%.2f,\"black_score\":%.2f,",
+		  white_score, black_score);
+
+  analysis_printf("\"top\":[");
+  for (k = 0; k < num_moves; k++) {
+    location_to_buffer(moves[k], buf);
+    analysis_printf("%s[\"%s\",%.2f]", k > 0 ? "," : "",
+		    buf, potential_moves[moves[k]]);
+  }
+
+  analysis_printf("],\"dragons\":[");
+  k = 0;
+  for (pos = BOARDMIN; pos < BOARDMAX; pos++) {
+    if (!IS_STONE(board[pos]) || dragon[pos].origin != pos)
+      continue;
+    location_to_buffer(pos, buf);
+    analysis_printf("%s{\"origin\":\"%s\",\"color\":\"%s\",\"stones\":%d,"
+		    "\"status\":\"%s\"}", k++ > 0 ? "," : "",
+		    buf, color_to_string(board[pos]), dragon[pos].size,
+		    status_to_string(dragon[pos].crude_status));
+  }
+  analysis_printf("]}");
+
+  return analysis;
+}
+
+/* Load the position in board into the session and analyze it. */
+char *analyze(char *board, int top_n)
+{
+  if (!session_active)
+    new_session(0);
+
+  if (!session_load(board))
+    return "";
+
+  return session_analyze(top_n);
+}
+
+/* Batch entry points. The games of an sgf collection, i.e. game trees
+ * written back to back, are handled one after another in the session,
+ * so the engine is initialized only once for the whole batch.
+ */
+
+/* Return the start of the next game tree in the collection, or NULL if
+ * there is none.
+ */
+static char *
+next_game(char *collection)
+{
+  char *p;
+
+  for (p = strchr(collection, '('); p; p = strchr(p + 1, '(')) {
+    char *q = p + 1;
+    while (*q == '(' || isspace((int) *q))
+      q++;
+    if (*q == ';')
+      return p;
+  }
+  return NULL;
+}
+
+/* Load the next game of the collection into the session and advance
+ * *collection past it. Return 0 if there are no more games, -1 if
+ * the game could not be loaded and 1 on success.
+ */
+static int
+load_next_game(char **collection)
+{
+  char *game = next_game(*collection);
+  int result;
+
+  if (game == NULL)
+    return 0;
+
+  result = session_load(game);
+  *collection = game + get_sgf_content_read();
+  return result ? 1 : -1;
+}
+
+/* Score each game of the collection. The k:th score is written to
+ * results[k], 0.0 for games which could not be loaded. Return the
+ * number of games scored, at most max_games.
+ */
+int score_batch(int seed, char *collection, float *results, int max_games)
+{
+  int num_games = 0;
+  int status;
+
+  new_session(seed);
+  while (num_games < max_games
+	 && (status = load_next_game(&collection)) != 0) {
+    if (status > 0) {
+      outfilename[0] = '*';
+      set_in_memory_content();
+      results[num_games] = load_and_score_sgf_file(&session_tree,
+						   &session_gameinfo, "");
+    }
+    else
+      results[num_games] = 0.0;
+    num_games++;
+  }
+
+  return num_games;
+}
+
+/* The record of the game which did not fit into the output of the
+ * last play_batch() call, together with the game and the seed it was
+ * generated from. See play_batch().
+ */
+static char *pending_game = NULL;
+static int pending_game_length = 0;
+static int pending_seed = 0;
+static char *pending_record = NULL;
+static int pending_length = 0;
+
+static void
+clear_pending_record(void)
+{
+  free(pending_game);
+  free(pending_record);
+  pending_game = NULL;
+  pending_record = NULL;
+}
+
+/* Keep the record of game, which ends at end, for the next call. */
+static void
+keep_pending_record(int seed, const char *game, const char *end,
+		    const char *record, int length)
+{
+  clear_pending_record();
+  pending_game_length = end - game;
+  pending_game = malloc(pending_game_length);
+  pending_record = malloc(length);
+  if (pending_game == NULL || pending_record == NULL) {
+    clear_pending_record();
+    return;
+  }
+  memcpy(pending_game, game, pending_game_length);
+  memcpy(pending_record, record, length);
+  pending_length = length;
+  pending_seed = seed;
+}
+
+/* Generate a move for each game of the collection. The game records
+ * are written back to back into output, and lengths[k] is set to the
+ * length of the k:th record, 0 for games which could not be loaded.
+ * Stop when the next record would not fit into output_size bytes.
+ * Return the number of games handled, at most max_games.
+ *
+ * If fewer than max_games games were handled although more remain,
+ * the caller resumes with a collection of the remaining games, i.e.
+ * without the first num_games game trees, and the same seed. The
+ * record which did not fit is kept, so that the move of the first of
+ * these games is not generated again.
+ */
+int play_batch(int seed, char *collection, char *output, int output_size,
+	       int *lengths, int max_games)
+{
+  int num_games = 0;
+  int used = 0;
+  int status;
+
+  new_session(seed);
+  while (num_games < max_games) {
+    char *game = next_game(collection);
+    char *record;
+    int length;
+
+    status = load_next_game(&collection);
+    if (status == 0)
+      break;
+
+    lengths[num_games] = 0;
+    if (status > 0) {
+      if (num_games == 0 && pending_record
+	  && pending_seed == seed
+	  && pending_game_length == collection - game
+	  && memcmp(pending_game, game, pending_game_length) == 0) {
+	record = pending_record;
+	length = pending_length;
+      }
+      else {
+	record = session_genmove();
+	length = get_sgf_content_length();
+      }
+
+      if (used + length > output_size) {
+	if (record != pending_record)
+	  keep_pending_record(seed, game, collection, record, length);
+	return num_games;
+      }
+      memcpy(output + used, record, length);
+      used += length;
+      lengths[num_games] = length;
+    }
+    num_games++;
+  }
+
+  clear_pending_record();
+  return num_games;
+}
+
+char *session_play(char *board)
+{
+  if (!session_active)
+    new_session(0);
+
+  if (!session_load(board))
+    return "";
+
+  return session_genmove();
+}
+
+float session_score(char *board)
+{
+  if (!session_active)
+    new_session(0);
+
+  if (!session_load(board))
+    return 0.0;
+
+  outfilename[0] = '*';
+  set_in_memory_content();
+  return load_and_score_sgf_file(&session_tree, &session_gameinfo, "");
+}
@@ -0,0 +1,694 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * This is GNU Go, a Go program. Contact gnugo@gnu.org, or see       *
+ * http://www.gnu.org/software/gnugo/ for more information.          *
+ *                                                                   *
+ * Copyright 1999, 2000, 2001, 2002, 2003, 2004, 2005, 2006, 2007,   *
+ * 2008, 2009, 2010 and 2011 by the Free Software Foundation.        *
+ *                                                                   *
+ * This program is free software; you can redistribute it and/or     *
+ * modify it under the terms of the GNU General Public License as    *
+ * published by the Free Software Foundation - version 3 or          *
+ * (at your option) any later version.                               *
+ *                                                                   *
+ * This program is distributed in the hope that it will be useful,   *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of    *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the     *
+ * GNU General Public License in file COPYING for more details.      *
+ *                                                                   *
+ * You should have received a copy of the GNU General Public         *
+ * License along with this program; if not, write to the Free        *
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,       *
+ * Boston, MA 02111, USA.                                            *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Batch processing of a stream of positions.
+ *
+ * Each input line holds one game, either as plain sgf or, in JSONL
+ * mode, as a JSON object
+ *
+ *   {"id":"game-17","seed":3,"sgf":"(;GM[1]SZ[9];B[ee])"}
+ *
+ * where "id" and "seed" are optional. For every game one output line
+ * is written, in input order. In plain mode it is the game record
+ * (with line breaks turned into spaces), the score or the analysis
+ * JSON, and an empty line if the game could not be loaded. In JSONL
+ * mode it is an object {"id":...,"result":...}, or with "error"
+ * instead of "result". Without an id the line number is used.
+ *
+ * The engine keeps its state in globals, so games are run in parallel
+ * in worker processes. The engine is initialized before the workers
+ * are forked, so they share the tables and start right away. Every
+ * worker has at most one game at a time; its result is sent back as a
+ * length line followed by the output line. Workers are used even for a
+ * single job: the engine assertions exit on errors, and a worker which
+ * dies is simply replaced.
+ */
+
+#include "gnugo.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#if HAVE_FORK
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#include "interface.h"
+#include "gg_utils.h"
+
+/* Number of results per worker which may be kept waiting for an
+ * earlier, slower game before no more games are handed out.
+ */
+#define STREAM_WINDOW_PER_JOB 4
+
+/* Read a line of any length, without the line break. Return NULL at
+ * end of file. The line must be freed by the caller.
+ */
+static char *
+read_line(FILE *input)
+{
+  int size = 256;
+  int length = 0;
+  char *line = malloc(size);
+  int c;
+
+  if (line == NULL)
+    return NULL;
+
+  while ((c = getc(input)) != EOF && c != '\n') {
+    if (length + 1 >= size) {
+      char *bigger = realloc(line, 2 * size);
+      if (bigger == NULL) {
+	free(line);
+	return NULL;
+      }
+      line = bigger;
+      size *= 2;
+    }
+    line[length++] = c;
+  }
+
+  if (c == EOF && length == 0) {
+    free(line);
+    return NULL;
+  }
+
+  if (length > 0 && line[length - 1] == '\r')
+    length--;
+  line[length] = '\0';
+  return line;
+}
+
+
+/* Read the next line which is not blank and count the lines read in
+ * *line_number. Return NULL at end of file.
+ */
+static char *
+read_game(FILE *input, int *line_number)
+{
+  char *line;
+
+  while ((line = read_line(input)) != NULL) {
+    char *p = line;
+    (*line_number)++;
+    while (isspace((int) *p))
+      p++;
+    if (*p)
+      return line;
+    free(line);
+  }
+
+  return NULL;
+}
+
+
+/* Minimal JSON support for the JSONL mode. Only what is needed to
+ * pick the members of a flat object is implemented.
+ */
+
+static const char *
+json_skip_space(const char *p)
+{
+  while (isspace((int) *p))
+    p++;
+  return p;
+}
+
+/* Return a pointer just past the JSON value starting at p. */
+static const char *
+json_skip_value(const char *p)
+{
+  int depth = 0;
+
+  while (*p) {
+    if (*p == '"') {
+      for (p++; *p && *p != '"'; p++)
+	if (*p == '\\' && p[1])
+	  p++;
+      if (*p)
+	p++;
+      if (depth == 0)
+	return p;
+      continue;
+    }
+
+    if (*p == '{' || *p == '[')
+      depth++;
+    else if (*p == '}' || *p == ']') {
+      if (depth == 0)
+	return p;
+      if (--depth == 0)
+	return p + 1;
+    }
+    else if (*p == ',' && depth == 0)
+      return p;
+    p++;
+  }
+
+  return p;
+}
+
+/* Find the member key of the object in line. Return a pointer to its
+ * value, or NULL if there is no such member.
+ */
+static const char *
+json_find(const char *line, const char *key)
+{
+  const char *p = json_skip_space(line);
+  int key_length = strlen(key);
+
+  if (*p != '{')
+    return NULL;
+  p++;
+
+  while (1) {
+    const char *name;
+    p = json_skip_space(p);
+    if (*p != '"')
+      return NULL;
+    name = p + 1;
+    p = json_skip_value(p);
+    p = json_skip_space(p);
+    if (*p != ':')
+      return NULL;
+    p = json_skip_space(p + 1);
+    if (strncmp(name, key, key_length) == 0 && name[key_length] == '"')
+      return p;
+    p = json_skip_space(json_skip_value(p));
+    if (*p != ',')
+      return NULL;
+    p++;
+  }
+}
+
+/* Decode the JSON string starting at p. Return a newly allocated
+ * string or NULL if p is not a string.
+ */
+static char *
+json_string(const char *p)
+{
+  char *s;
+  char *q;
+
+  if (p == NULL || *p != '"')
+    return NULL;
+
+  s = malloc(strlen(p) + 1);
+  if (s == NULL)
+    return NULL;
+
+  for (p++, q = s; *p && *p != '"'; p++) {
+    if (*p != '\\') {
+      *q++ = *p;
+      continue;
+    }
+    switch (*++p) {
+    case 'b': *q++ = '\b'; break;
+    case 'f': *q++ = '\f'; break;
+    case 'n': *q++ = '\n'; break;
+    case 'r': *q++ = '\r'; break;
+    case 't': *q++ = '\t'; break;
+    case 'u':
+      {
+	unsigned int c = 0;
+	int k;
+	for (k = 1; k <= 4 && isxdigit((int) p[k]); k++)
+	  c = 16 * c + (isdigit((int) p[k]) ? p[k] - '0'
+			: tolower((int) p[k]) - 'a' + 10);
+	p += k - 1;
+	/* Encode as UTF-8. */
+	if (c < 0x80)
+	  *q++ = c;
+	else if (c < 0x800) {
+	  *q++ = 0xc0 | (c >> 6);
+	  *q++ = 0x80 | (c & 0x3f);
+	}
+	else {
+	  *q++ = 0xe0 | (c >> 12);
+	  *q++ = 0x80 | ((c >> 6) & 0x3f);
+	  *q++ = 0x80 | (c & 0x3f);
+	}
+      }
+      break;
+    case '\0':
+      p--;
+      break;
+    default:
+      *q++ = *p;
+      break;
+    }
+  }
+  *q = '\0';
+
+  return s;
+}
+
+/* Write s as a JSON string to q. Return a pointer past the end. q
+ * must have room for 6 * strlen(s) + 3 characters.
+ */
+static char *
+json_escape(char *q, const char *s)
+{
+  *q++ = '"';
+  for (; *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\') {
+      *q++ = '\\';
+      *q++ = c;
+    }
+    else if (c == '\n') {
+      *q++ = '\\';
+      *q++ = 'n';
+    }
+    else if (c < 0x20) {
+      sprintf(q, "\\u%04x", c);
+      q += 6;
+    }
+    else
+      *q++ = c;
+  }
+  *q++ = '"';
+  *q = '\0';
+  return q;
+}
+
+
+/* Run the game in line and return the output line, without line
+ * break, in a newly allocated string. number is the line number,
+ * used as id of JSONL games without one.
+ */
+static char *
+stream_game(const char *line, int number, int mode, int jsonl, int seed)
+{
+  char *sgf;
+  char *id;
+  char *output;
+  char *result = NULL;
+  char *error = NULL;
+  char score_buffer[32];
+  char *q;
+
+  if (jsonl) {
+    const char *value = json_find(line, "id");
+    if (value) {
+      int length = json_skip_value(value) - value;
+      while (length > 0 && isspace((int) value[length - 1]))
+	length--;
+      id = malloc(length + 1);
+      memcpy(id, value, length);
+      id[length] = '\0';
+    }
+    else {
+      id = malloc(16);
+      sprintf(id, "%d", number);
+    }
+
+    value = json_find(line, "seed");
+    if (value)
+      seed = atoi(value);
+
+    sgf = json_string(json_find(line, "sgf"));
+    if (sgf == NULL)
+      error = "no sgf member";
+  }
+  else {
+    id = NULL;
+    sgf = malloc(strlen(line) + 1);
+    strcpy(sgf, line);
+  }
+
+  if (sgf) {
+    new_session(seed);
+    if (mode == STREAM_SCORE) {
+      float score = session_score(sgf);
+      gg_snprintf(score_buffer, sizeof(score_buffer), "%.1f", score);
+      result = score_buffer;
+    }
+    else if (mode == STREAM_ANALYZE)
+      result = analyze(sgf, -1);
+    else
+      result = session_play(sgf);
+
+    /* The session drops the game if it cannot be loaded. */
+    if (!session_has_game()) {
+      result = NULL;
+      error = "cannot load game";
+    }
+  }
+
+  if (!jsonl) {
+    int length;
+    output = malloc(result ? strlen(result) + 1 : 1);
+    strcpy(output, result ? result : "");
+    length = strlen(output);
+    while (length > 0 && isspace((int) output[length - 1]))
+      length--;
+    output[length] = '\0';
+    for (q = output; *q; q++)
+      if (*q == '\n' || *q == '\r')
+	*q = ' ';
+  }
+  else {
+    output = malloc(strlen(id) + 6 * (result ? strlen(result) : 0) + 64);
+    q = output + sprintf(output, "{\"id\":%s,", id);
+    if (error) {
+      q += sprintf(q, "\"error\":");
+      q = json_escape(q, error);
+    }
+    else {
+      q += sprintf(q, "\"result\":");
+      if (mode == STREAM_PLAY)
+	q = json_escape(q, result);
+      else
+	q += sprintf(q, "%s", result);
+    }
+    sprintf(q, "}");
+  }
+
+  free(sgf);
+  free(id);
+  return output;
+}
+
+
+#if HAVE_FORK
+
+struct stream_worker {
+  pid_t pid;
+  FILE *to_worker;
+  FILE *from_worker;
+  int job;		/* game being handled, -1 if idle */
+};
+
+/* Main loop of a worker process: run the games sent on input and
+ * send back the results.
+ */
+static void
+stream_worker_loop(FILE *input, FILE *output, int mode, int jsonl, int seed)
+{
+  char *line;
+  int number;
+
+  while ((line = read_line(input)) != NULL) {
+    char *result;
+    if (sscanf(line, "%d", &number) == 1) {
+      result = stream_game(strchr(line, ' ') + 1, number, mode, jsonl, seed);
+      fprintf(output, "%d\n", (int) strlen(result));
+      fputs(result, output);
+      fflush(output);
+      free(result);
+    }
+    free(line);
+  }
+}
+
+/* Fork worker k. The descriptors of the other workers are closed in
+ * the child, so that each worker sees end of file when the parent
+ * closes its input.
+ */
+static int
+stream_spawn(struct stream_worker *workers, int num_workers, int k,
+	     FILE *output, int mode, int jsonl, int seed)
+{
+  int to_worker[2];
+  int from_worker[2];
+  int j;
+
+  if (pipe(to_worker) != 0)
+    return 0;
+  if (pipe(from_worker) != 0) {
+    close(to_worker[0]);
+    close(to_worker[1]);
+    return 0;
+  }
+
+  fflush(output);
+  workers[k].pid = fork();
+  if (workers[k].pid < 0) {
+    close(to_worker[0]);
+    close(to_worker[1]);
+    close(from_worker[0]);
+    close(from_worker[1]);
+    return 0;
+  }
+
+  if (workers[k].pid == 0) {
+    FILE *input;
+    FILE *result;
+
+    for (j = 0; j < num_workers; j++)
+      if (j != k && workers[j].pid > 0) {
+	close(fileno(workers[j].to_worker));
+	close(fileno(workers[j].from_worker));
+      }
+    close(to_worker[1]);
+    close(from_worker[0]);
+    input = fdopen(to_worker[0], "r");
+    result = fdopen(from_worker[1], "w");
+    stream_worker_loop(input, result, mode, jsonl, seed);
+    /* Leave the stdio buffers inherited from the parent alone. */
+    _exit(0);
+  }
+
+  close(to_worker[0]);
+  close(from_worker[1]);
+  workers[k].to_worker = fdopen(to_worker[1], "w");
+  workers[k].from_worker = fdopen(from_worker[0], "r");
+  workers[k].job = -1;
+  return 1;
+}
+
+/* Read the result of worker k. Return NULL if the worker has died. */
+static char *
+stream_receive(struct stream_worker *worker)
+{
+  int length;
+  char *result;
+
+  /* Read the line break by hand; "\n" in the format would wait for
+   * the next non-blank character, which never comes for an empty
+   * result.
+   */
+  if (fscanf(worker->from_worker, "%d", &length) != 1 || length < 0
+      || getc(worker->from_worker) != '\n')
+    return NULL;
+  result = malloc(length + 1);
+  if (result == NULL
+      || (int) fread(result, 1, length, worker->from_worker) != length) {
+    free(result);
+    return NULL;
+  }
+  result[length] = '\0';
+  return result;
+}
+
+static void
+stream_stop(struct stream_worker *worker)
+{
+  int status;
+  fclose(worker->to_worker);
+  fclose(worker->from_worker);
+  waitpid(worker->pid, &status, 0);
+  worker->pid = 0;
+}
+
+/* Hand out the games to num_workers worker processes and write the
+ * results in input order. Return 0 if no worker could be started.
+ */
+static int
+play_stream_parallel(FILE *input, FILE *output, int mode, int jsonl,
+		     int num_workers, int seed)
+{
+  struct stream_worker *workers = calloc(num_workers, sizeof(*workers));
+  struct pollfd *fds = calloc(num_workers, sizeof(*fds));
+  int *fd_worker = calloc(num_workers, sizeof(*fd_worker));
+  int window = STREAM_WINDOW_PER_JOB * num_workers;
+  char **results = calloc(window, sizeof(*results));
+  int *numbers = calloc(window, sizeof(*numbers));
+  int next_job = 0;
+  int next_output = 0;
+  int line_number = 0;
+  int end_of_input = 0;
+  int k;
+
+  for (k = 0; k < num_workers; k++)
+    if (!stream_spawn(workers, num_workers, k, output, mode, jsonl, seed)) {
+      fprintf(stderr, "gnugo: cannot start worker process\n");
+      num_workers = k;
+      break;
+    }
+
+  if (num_workers == 0) {
+    free(workers);
+    free(fds);
+    free(fd_worker);
+    free(results);
+    free(numbers);
+    return 0;
+  }
+
+  while (1) {
+    int num_fds = 0;
+
+    /* Give a game to every idle worker. */
+    for (k = 0; k < num_workers && !end_of_input; k++) {
+      char *line;
+      if (workers[k].pid <= 0 || workers[k].job >= 0
+	  || next_job - next_output >= window)
+	continue;
+      line = read_game(input, &line_number);
+      if (line == NULL) {
+	end_of_input = 1;
+	break;
+      }
+      numbers[next_job % window] = line_number;
+      fprintf(workers[k].to_worker, "%d %s\n", line_number, line);
+      fflush(workers[k].to_worker);
+      workers[k].job = next_job++;
+      free(line);
+    }
+
+    for (k = 0; k < num_workers; k++)
+      if (workers[k].job >= 0) {
+	fds[num_fds].fd = fileno(workers[k].from_worker);
+	fds[num_fds].events = POLLIN;
+	fds[num_fds].revents = 0;
+	fd_worker[num_fds] = k;
+	num_fds++;
+      }
+
+    if (num_fds == 0)
+      break;
+
+    if (poll(fds, num_fds, -1) < 0)
+      continue;
+
+    for (k = 0; k < num_fds; k++) {
+      struct stream_worker *worker = &workers[fd_worker[k]];
+      char *result;
+      if (fds[k].revents == 0)
+	continue;
+
+      result = stream_receive(worker);
+      if (result == NULL) {
+	/* The worker has died, e.g. on a failed assertion. Report the
+	 * game and start a new worker.
+	 */
+	int number = numbers[worker->job % window];
+	result = malloc(64);
+	if (jsonl)
+	  sprintf(result, "{\"id\":%d,\"error\":\"engine failure\"}", number);
+	else
+	  result[0] = '\0';
+	fprintf(stderr, "gnugo: worker died on line %d\n", number);
+	stream_stop(worker);
+	results[worker->job % window] = result;
+	if (!stream_spawn(workers, num_workers, fd_worker[k], output,
+			  mode, jsonl, seed)) {
+	  fprintf(stderr, "gnugo: cannot restart worker process\n");
+	  end_of_input = 1;
+	  worker->pid = 0;
+	}
+	worker->job = -1;
+	continue;
+      }
+      results[worker->job % window] = result;
+      worker->job = -1;
+    }
+
+    /* Write the results which are next in input order. */
+    while (results[next_output % window]) {
+      fprintf(output, "%s\n", results[next_output % window]);
+      free(results[next_output % window]);
+      results[next_output % window] = NULL;
+      next_output++;
+    }
+    fflush(output);
+  }
+
+  for (k = 0; k < num_workers; k++)
+    if (workers[k].pid > 0)
+      stream_stop(&workers[k]);
+
+  free(workers);
+  free(fds);
+  free(fd_worker);
+  free(results);
+  free(numbers);
+  return 1;
+}
+
+#endif
+
+
+/* Run the games one after another in this process. */
+static void
+play_stream_sequential(FILE *input, FILE *output, int mode, int jsonl,
+		       int seed)
+{
+  char *line;
+  int line_number = 0;
+
+  while ((line = read_game(input, &line_number)) != NULL) {
+    char *result = stream_game(line, line_number, mode, jsonl, seed);
+    fprintf(output, "%s\n", result);
+    fflush(output);
+    free(result);
+    free(line);
+  }
+}
+
+
+/* Run every game on input and write one line per game to output,
+ * using jobs worker processes where available.
+ */
+void
+play_stream(FILE *input, FILE *output, int mode, int jsonl, int jobs,
+	    int seed)
+{
+  /* Initialize the engine once, before any worker is started. */
+  new_session(seed);
+
+#if HAVE_FORK
+  if (play_stream_parallel(input, output, mode, jsonl, jobs, seed))
+    return;
+#else
+  if (jobs > 1)
+    fprintf(stderr, "gnugo: no worker processes on this platform\n");
+#endif
+
+  play_stream_sequential(input, output, mode, jsonl, seed);
+}
+
+
+/*
+ * Local Variables:
+ * tab-width: 8
+ * c-basic-offset: 2
+ * End:
+ */
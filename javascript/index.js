@@ -1,14 +1,26 @@
-let loader = require("./gnugo.js");
-loader.get("./gnugo.wasm").then(Module => {
+let GnugoPool = require("./pool.js");
+let pool = new GnugoPool("./gnugo.wasm");
+let pending = null;
+
+Promise.all(pool.workers.map(slot => slot.ready)).then(() => {
   document.querySelector("#gnugoOutput").innerHTML = "Ready to play!";
-  document.querySelector("#playButton").addEventListener("click", function () {
-    let input = document.querySelector("#textInput").value;
-    let output = Module.ccall(
-      "play",
-      "string",
-      ["number", "string"],
-      [0, input]
-    );
-    document.querySelector("#gnugoOutput").innerHTML = output;
-  });
+});
+
+document.querySelector("#playButton").addEventListener("click", function () {
+  let input = document.querySelector("#textInput").value;
+  if (pending) {
+    pending.cancel();
+  }
+  document.querySelector("#gnugoOutput").innerHTML = "Thinking...";
+  pending = pool.play(input);
+  pending.then(
+    output => {
+      document.querySelector("#gnugoOutput").innerHTML = output;
+    },
+    error => {
+      if (error.message !== "cancelled") {
+        document.querySelector("#gnugoOutput").innerHTML = error.message;
+      }
+    }
+  );
 });
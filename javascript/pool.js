@@ -0,0 +1,125 @@
+// A pool of gnugo.wasm instances, each in its own dedicated worker, so
+// that move generation neither blocks the page nor waits for another
+// analysis to finish.
+//
+//   let pool = new GnugoPool("./gnugo.wasm");
+//   let request = pool.play(sgf);
+//   request.then(output => ...);
+//   request.cancel();
+//
+// Requests wait in a queue until a worker is free. Cancelling a queued
+// request removes it from the queue; cancelling a running one
+// terminates its worker, since a synchronous wasm call can't be
+// interrupted, and starts a fresh one in its place.
+
+class GnugoPool {
+  constructor(wasmURL, size) {
+    this.wasmURL = new URL(wasmURL, self.location.href).href;
+    this.size = size || self.navigator.hardwareConcurrency || 2;
+    this.queue = [];
+    this.workers = [];
+    this.nextId = 0;
+    for (let i = 0; i < this.size; i++) {
+      this.workers.push(this.spawn());
+    }
+  }
+
+  spawn() {
+    let slot = { worker: new Worker("./worker.js"), request: null };
+    slot.ready = new Promise((resolve, reject) => {
+      slot.request = { id: -1, resolve, reject };
+    });
+    slot.worker.onmessage = event => this.receive(slot, event.data);
+    slot.worker.postMessage({
+      id: -1,
+      method: "init",
+      wasmURL: this.wasmURL
+    });
+    return slot;
+  }
+
+  play(sgf, seed = 0) {
+    return this.submit("play", [seed, sgf]);
+  }
+
+  score(sgf, seed = 0) {
+    return this.submit("score", [seed, sgf]);
+  }
+
+  analyze(sgf, topN = 10) {
+    return this.submit("analyze", [sgf, topN]);
+  }
+
+  submit(method, args) {
+    let request = { id: this.nextId++, method, args };
+    let promise = new Promise((resolve, reject) => {
+      request.resolve = resolve;
+      request.reject = reject;
+    });
+    promise.cancel = () => this.cancel(request);
+    this.queue.push(request);
+    this.dispatch();
+    return promise;
+  }
+
+  cancel(request) {
+    let index = this.queue.indexOf(request);
+    if (index >= 0) {
+      this.queue.splice(index, 1);
+    } else {
+      let slotIndex = this.workers.findIndex(slot => slot.request === request);
+      if (slotIndex < 0) {
+        return false;
+      }
+      this.workers[slotIndex].worker.terminate();
+      this.workers[slotIndex] = this.spawn();
+    }
+    request.reject(new Error("cancelled"));
+    this.dispatch();
+    return true;
+  }
+
+  dispatch() {
+    for (let slot of this.workers) {
+      if (this.queue.length === 0) {
+        return;
+      }
+      if (slot.request === null) {
+        let request = this.queue.shift();
+        slot.request = request;
+        slot.worker.postMessage({
+          id: request.id,
+          method: request.method,
+          args: request.args
+        });
+      }
+    }
+  }
+
+  receive(slot, { id, result, error }) {
+    let request = slot.request;
+    if (request === null || request.id !== id) {
+      return;
+    }
+    slot.request = null;
+    if (error !== undefined) {
+      request.reject(new Error(error));
+    } else {
+      request.resolve(result);
+    }
+    this.dispatch();
+  }
+
+  terminate() {
+    for (let slot of this.workers) {
+      slot.worker.terminate();
+    }
+    for (let request of this.queue) {
+      request.reject(new Error("terminated"));
+    }
+    this.queue = [];
+    this.workers = [];
+  }
+}
+
+module.exports = GnugoPool;
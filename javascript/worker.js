@@ -0,0 +1,89 @@
+// A dedicated worker running one gnugo.wasm instance. Requests are
+// posted as {id, method, args} and answered with {id, result} or
+// {id, error}. The engine session stays alive between requests.
+let loader = require("./gnugo.js");
+
+const methods = {
+  play: (Module, [seed, sgf]) => {
+    Module.ccall("new_session", null, ["number"], [seed]);
+    return Module.ccall("session_play", "string", ["string"], [sgf]);
+  },
+  score: (Module, [seed, sgf]) => {
+    Module.ccall("new_session", null, ["number"], [seed]);
+    return Module.ccall("session_score", "number", ["string"], [sgf]);
+  },
+  analyze: (Module, [sgf, topN]) => {
+    Module.ccall("new_session", null, ["number"], [0]);
+    let output = Module.ccall(
+      "analyze",
+      "string",
+      ["string", "number"],
+      [sgf, topN]
+    );
+    return output === "" ? null : JSON.parse(output);
+  }
+};
+
+// Index of the sgf argument of each method.
+const sgfArgument = { play: 1, score: 1, analyze: 0 };
+
+let ready = null;
+let baseURL = null;
+
+// Builds configured with --enable-lazy-fuseki leave the 13x13 and
+// 19x19 fuseki databases out of the module. They are fetched from
+// next to the wasm file the first time a game of that size comes in.
+function loadFuseki(Module, sgf) {
+  let match = /SZ\[(\d+)\]/.exec(sgf);
+  let size = match ? parseInt(match[1], 10) : 19;
+  if (!Module.ccall("need_fuseki", "number", ["number"], [size]))
+    return Promise.resolve();
+  return fetch(new URL(`fuseki${size}.bin`, baseURL))
+    .then(response => {
+      if (!response.ok)
+        throw new Error(`fuseki${size}.bin: ${response.status}`);
+      return response.arrayBuffer();
+    })
+    .then(buffer => {
+      let data = new Uint8Array(buffer);
+      let ptr = Module._malloc(data.length);
+      Module.HEAPU8.set(data, ptr);
+      Module.ccall(
+        "load_fuseki",
+        "number",
+        ["number", "number"],
+        [ptr, data.length]
+      );
+      Module._free(ptr);
+    });
+}
+
+self.onmessage = function (event) {
+  let { id, method, args, wasmURL } = event.data;
+  if (method === "init") {
+    baseURL = new URL(wasmURL, self.location.href);
+    // Set up the engine tables while the worker is idle, rather than
+    // in the first request. Modules built before init_tables was
+    // exported do it in the first request as before.
+    ready = loader.get(wasmURL).then(Module => {
+      if (Module._init_tables)
+        Module.ccall("init_tables", null, [], []);
+      return Module;
+    });
+    ready.then(
+      () => self.postMessage({ id, result: true }),
+      error => self.postMessage({ id, error: String(error) })
+    );
+    return;
+  }
+  ready
+    .then(Module =>
+      loadFuseki(Module, args[sgfArgument[method]]).then(() =>
+        methods[method](Module, args)
+      )
+    )
+    .then(
+      result => self.postMessage({ id, result }),
+      error => self.postMessage({ id, error: String(error) })
+    );
+};
@@ -43,6 +43,14 @@
 #define OUT_BOARD 3		/* # */
 
 
+/* The board as seen by the matcher, indexed by DFA_POS() and with a
+ * border of OUT_BOARD wide enough for any pattern. dfa_board[0] has
+ * the colors of the board, dfa_board[1] has them swapped. Both are
+ * kept up to date by board.c as stones are played and taken back.
+ */
+extern unsigned char dfa_board[2][DFA_BASE * DFA_BASE];
+
+
 /* Maximum pattern matched at one positions. */
 #define DFA_MAX_MATCHED		(8 * 24)
 
@@ -292,6 +292,17 @@ struct fullboard_pattern {
   int value;			/* value for pattern, if matched */
 };
 
+/* Hash table over a fullboard pattern database, built by
+ * fullboard_index_init(). The patterns with the same hash value are
+ * linked in database order.
+ */
+struct fullboard_index {
+  struct fullboard_pattern *patterns;	/* The indexed database. */
+  int num_slots;		/* Size of the hash table. */
+  int *slots;			/* First pattern in each slot, or -1. */
+  int *next;			/* Next pattern with the same hash, or -1. */
+};
+
 
 /* Monte Carlo local patterns. */
 struct mc_pattern_database {
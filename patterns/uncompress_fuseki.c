@@ -36,6 +36,7 @@
 Usage :\
 uncompress_fuseki boardsize filename c\n\
 uncompress_fuseki boardsize filename db\n\
+uncompress_fuseki boardsize filename bin\n\
 "
 
 #define DB_PREAMBLE "\
@@ -101,10 +102,20 @@ uncompress_fuseki boardsize filename db\n\
 #define C_HEADER "struct fullboard_pattern fuseki%d[] = {\n"
 #define C_FOOTER "};\n"
   
+/* The binary format is what load_fuseki_database() reads at runtime:
+ * a text header line followed by one record per pattern. See
+ * write_pattern_bin() for the record layout.
+ */
+#define BIN_PREAMBLE ""
+#define BIN_HEADER "GNU Go fuseki %d\n"
+#define BIN_FOOTER ""
+
 static const char *const db_output_strings[3] =
   {DB_PREAMBLE, DB_HEADER, DB_FOOTER};
 static const char *const c_output_strings[3] =
   {C_PREAMBLE, C_HEADER, C_FOOTER};
+static const char *const bin_output_strings[3] =
+  {BIN_PREAMBLE, BIN_HEADER, BIN_FOOTER};
 
 #define PREAMBLE 	0
 #define HEADER 		1
@@ -231,8 +242,56 @@ write_pattern_c_code(char *name, Intersection board1d[BOARDSIZE],
 }
 
 
+
+/* Write a 32 bit big endian integer. */
+static void
+write_bin_int(int value)
+{
+  unsigned int u = (unsigned int) value;
+  putchar((u >> 24) & 0xff);
+  putchar((u >> 16) & 0xff);
+  putchar((u >> 8) & 0xff);
+  putchar(u & 0xff);
+}
+
+/* A binary record consists of the NUM_HASHBITS bits of the hash
+ * value, most significant bit of the first hashvalue first, followed
+ * by the number of stones, the move offset and the value as 32 bit
+ * big endian integers and the NUL terminated pattern name. Writing
+ * the hash as a bit stream makes the file independent of the size of
+ * a long on the target.
+ */
+static void
+write_pattern_bin(char *name, Intersection board1d[BOARDSIZE],
+		  int move_pos, int value, int boardsize, int patlen)
+{
+  Hash_data pattern_hash;
+  int bits_in_hashvalue = CHAR_BIT * SIZEOF_HASHVALUE;
+  int byte = 0;
+  int k;
+
+  hashdata_recalc(&pattern_hash, board1d, NO_MOVE);
+  for (k = 0; k < NUM_HASHBITS; k++) {
+    Hashvalue h = pattern_hash.hashval[k / bits_in_hashvalue];
+    int shift = bits_in_hashvalue - 1 - k % bits_in_hashvalue;
+    byte = (byte << 1) | (int) ((h >> shift) & 1);
+    if (k % 8 == 7) {
+      putchar(byte);
+      byte = 0;
+    }
+  }
+  write_bin_int(patlen);
+  write_bin_int(OFFSET(I(move_pos) - (boardsize-1)/2,
+		       J(move_pos) - (boardsize-1)/2));
+  write_bin_int(value);
+  fputs(name, stdout);
+  putchar('\0');
+}
+
+
 #define DB_OUTPUT 	1
 #define C_OUTPUT 	2
+#define BIN_OUTPUT 	3
 
 
 int
@@ -272,6 +331,12 @@ main(int argc, char *argv[])
     mode = DB_OUTPUT;
     output_strings = db_output_strings;
   }
+  else if (strncmp(argv[3], "bin", 4) == 0) {
+    mode = BIN_OUTPUT;
+    output_strings = bin_output_strings;
+    set_random_seed(HASH_RANDOM_SEED);
+    hash_init();
+  }
   else {
     fprintf(stderr, USAGE);
     return EXIT_FAILURE;
@@ -308,7 +373,13 @@ main(int argc, char *argv[])
 
   printf(output_strings[PREAMBLE]);
   printf(output_strings[HEADER], boardsize);
-  
+
+  /* With --enable-lazy-fuseki only the 9x9 database is compiled in.
+   * The larger ones are left empty and loaded at runtime from the
+   * files written in binary mode.
+   */
+  if (mode == C_OUTPUT && boardsize > 9)
+    printf("#if !LAZY_FUSEKI\n");
 
   /* Loop over the lines of the compressed database.
    * Each line is one pattern.
@@ -352,6 +423,9 @@ main(int argc, char *argv[])
 
     if (mode == DB_OUTPUT)
       write_pattern(name, board, value, boardsize);
+    else if (mode == BIN_OUTPUT)
+      write_pattern_bin(name, board1d, move_pos, value, boardsize,
+			num_stones);
     else
       write_pattern_c_code(name, board1d, move_pos, value, boardsize,
 		           num_stones);
@@ -360,6 +434,8 @@ main(int argc, char *argv[])
   /* Add a dummy pattern to mark the end of the array. This can't be
    * done statically in the footer since NUM_HASHVALUES may vary.
    */
+  if (mode == C_OUTPUT && boardsize > 9)
+    printf("#endif\n");
   if (mode == C_OUTPUT)
     write_pattern_c_code(NULL, board1d, NO_MOVE, 0, boardsize, -1);
   
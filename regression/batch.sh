@@ -0,0 +1,36 @@
+#!/bin/sh
+# batch.sh [OPTIONS ...]
+#
+# Check that gnugo --batch reports a game it cannot load as an empty
+# result, also when the game follows a good one in the same worker
+# process.  OPTIONS are passed directly to gnugo.
+
+if test ! "$GNUGO" ; then
+	GNUGO=`cd ../interface && pwd`/gnugo
+	if test ! -x "$GNUGO" ; then
+		echo ERROR: no such program: $GNUGO
+		exit 1
+	fi
+fi
+
+games='(;GM[1]SZ[9];B[ee];W[cc])
+(;GM[1]SZ[9;B[
+(;GM[1]SZ[9];B[ee];W[cc];B[gg])'
+
+status=0
+for jobs in "" "-j 1" "-j 2" ; do
+	result=`echo "$games" | $GNUGO --batch --score $jobs "$@" 2>/dev/null`
+	lines=`echo "$result" | wc -l`
+	words=`echo "$result" | wc -w`
+	second=`echo "$result" | sed -n 2p`
+	if test $lines -ne 3 -o -n "$second" -o $words -ne 2 ; then
+		echo "FAILED: --batch --score $jobs"
+		echo "$result"
+		status=1
+	fi
+done
+
+if test $status -eq 0 ; then
+	echo "batch: all tests passed"
+fi
+exit $status
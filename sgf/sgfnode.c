@@ -32,6 +32,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <assert.h>
+#include <setjmp.h>
 
 
 #if TIME_WITH_SYS_TIME
@@ -897,12 +898,19 @@ void setsgffile(char *content) {
   sgfcontentpos = 0;
 }
 
+/* Number of characters of the in-memory content consumed so far. After
+ * reading one game tree of a collection, the next one starts here.
+ */
+int get_sgf_content_read(void) {
+  return sgfcontentpos;
+}
+
 char sgf_getch() {
   if (sgfcontent) {
-    char c = sgfcontent[sgfcontentpos++];
-    if (c == NULL) {
+    char c = sgfcontent[sgfcontentpos];
+    if (c == '\0')
       return EOF;
-    }
+    sgfcontentpos++;
     return c;
   }
   return getc(sgffile);
@@ -914,6 +922,13 @@ static int sgferrarg;
 #endif
 static int sgferrpos;
 
+/* While readsgffile() is parsing, parse errors return there instead
+ * of exiting.
+ */
+static jmp_buf sgf_error_jump;
+static int sgf_error_jump_set = 0;
+static char sgf_error_message[80];
+
 static int lookahead;
 
 
@@ -925,6 +940,13 @@ static int lookahead;
 static void
 parse_error(const char *msg, int arg)
 {
+  if (sgf_error_jump_set) {
+    gg_snprintf(sgf_error_message, sizeof(sgf_error_message), msg, arg);
+    sgferr = sgf_error_message;
+    sgferrpos = sgfcontent ? sgfcontentpos : (int) ftell(sgffile);
+    longjmp(sgf_error_jump, 1);
+  }
+
   fprintf(stderr, msg, arg);
   fprintf(stderr, "\n");
   exit(EXIT_FAILURE);
@@ -1208,7 +1230,8 @@ readsgffilefuseki(const char *filename, int moves_per_game)
 SGFNode *
 readsgffile(const char *filename)
 {
-  SGFNode *root;
+  /* Static, so that it keeps its value after a parse error. */
+  static SGFNode *root;
   int tmpi = 0;
 
   if (strcmp(filename, "-") == 0)
@@ -1219,9 +1242,14 @@ readsgffile(const char *filename)
   if (!sgffile)
     return NULL;
 
-
-  nexttoken();
-  gametree(&root, NULL, LAX_SGF);
+  root = NULL;
+  sgferr = NULL;
+  if (setjmp(sgf_error_jump) == 0) {
+    sgf_error_jump_set = 1;
+    nexttoken();
+    gametree(&root, NULL, LAX_SGF);
+  }
+  sgf_error_jump_set = 0;
 
   if (sgffile != stdin)
     fclose(sgffile);
@@ -1257,23 +1285,47 @@ readsgffile(const char *filename)
 /* ================================================================ */
 /*                          Write SGF tree                          */
 /* ================================================================ */
-static char sgf_output_content[4096];
+/* In memory output for the wasm api. The buffer grows as needed and is
+ * kept between writes, so the caller gets a pointer into it together
+ * with the length of the content.
+ */
+#define SGF_OUTPUT_CHUNK 4096
+
+static char *sgf_output_content = NULL;
+static int sgf_output_content_size = 0;
 static int sgf_output_content_pos;
 static char in_memory_content;
 
 void set_in_memory_content(void) {
   in_memory_content = 1;
   sgf_output_content_pos = 0;
-  memset(sgf_output_content, 0, sizeof(sgf_output_content));
+  if (sgf_output_content == NULL) {
+    sgf_output_content_size = SGF_OUTPUT_CHUNK;
+    sgf_output_content = xalloc(sgf_output_content_size);
+  }
+  sgf_output_content[0] = '\0';
 }
 
 char *get_sgf_content(void) {
+  if (sgf_output_content == NULL)
+    return "";
   return sgf_output_content;
 }
 
+int get_sgf_content_length(void) {
+  return sgf_output_content_pos;
+}
+
 void putc_prime(int c, FILE *stream) {
   if (in_memory_content == 1) {
+    /* Keep room for the terminating NUL. */
+    if (sgf_output_content_pos + 1 >= sgf_output_content_size) {
+      sgf_output_content_size *= 2;
+      sgf_output_content = xrealloc(sgf_output_content,
+				    sgf_output_content_size);
+    }
     sgf_output_content[sgf_output_content_pos++] = c;
+    sgf_output_content[sgf_output_content_pos] = '\0';
   } else {
     fputc(c, stream);
   }
@@ -1436,7 +1488,9 @@ unparse_root(FILE *file, SGFNode *node)
   if (sgfHasProperty(node, "GM"))
     sgfPrintCharProperty(file, node, "GM");
   else {
-    fputs("GM[1]", file);
+    const char *gm = "GM[1]";
+    for (; *gm; gm++)
+      putc_prime(*gm, file);
     sgf_column += 5;
   }
   
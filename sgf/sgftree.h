@@ -121,9 +121,11 @@ int writesgf(SGFNode *root, const char *filename);
 
 /* In memory functions for wasm api */
 void setsgffile(char *content);
+int get_sgf_content_read(void);
 void putc_prime(int c, FILE *stream);
 void set_in_memory_content(void);
 char *get_sgf_content(void);
+int get_sgf_content_length(void);
 
 /* ---------------------------------------------------------------- */
 /* ---                          SGFTree                         --- */
@@ -70,7 +70,7 @@ static int rand_initialized = 0;
  */
 
 static void
-iterate_tgfsr(void)
+iterate_tgfsr(unsigned int x[N])
 {
   int i;
   for (i = 0; i < N - m; i++)
@@ -80,27 +80,36 @@ iterate_tgfsr(void)
 }
 
 
+/* Produce a random number from one word of the internal state. */
+
+static unsigned int
+temper(unsigned int word)
+{
+  unsigned int y;
+  y = word ^ ((word << s) & b);
+  y ^= ((y << t) & c);
+#if BIG_UINT
+  y &= 0xffffffffU;
+#endif
+  return y;
+}
+
+
 /* Produce a random number from the next word of the internal state.
  */
 
 static unsigned int
 next_rand(void)
 {
-  int y;
   if (!rand_initialized) {
     assert(rand_initialized); /* Abort. */
     gg_srand(1);              /* Initialize silently if assertions disabled. */
   }
   if (++k == N) {
-    iterate_tgfsr();
+    iterate_tgfsr(x);
     k = 0;
   }
-  y = x[k] ^ ((x[k] << s) & b);
-  y ^= ((y << t) & c);
-#if BIG_UINT
-  y &= 0xffffffffU;
-#endif
-  return y;
+  return temper(x[k]);
 }
 
 
@@ -180,6 +189,45 @@ gg_get_rand_state(struct gg_rand_state *state)
 }
 
 
+/* The same generator with the state kept by the caller instead of in
+ * the global state above. A state seeded with gg_srand_r() produces
+ * the same sequence as the global generator seeded with gg_srand(),
+ * but several states can be used independently, e.g. by different
+ * threads.
+ */
+
+void
+gg_srand_r(struct gg_rand_state *state, unsigned int seed)
+{
+  int i;
+  for (i = 0; i < N; i++) {
+#if BIG_UINT
+    seed &= 0xffffffffU;
+#endif
+    state->x[i] = seed;
+    seed *= 1313;
+    seed += 88897;
+  }
+  state->k = N-1;
+}
+
+unsigned int
+gg_urand_r(struct gg_rand_state *state)
+{
+  if (++state->k == N) {
+    iterate_tgfsr(state->x);
+    state->k = 0;
+  }
+  return temper(state->x[state->k]);
+}
+
+double
+gg_drand_r(struct gg_rand_state *state)
+{
+  return gg_urand_r(state) * 2.328306436538696e-10;
+}
+
+
 /* Set the internal state of the random number generator.
  */
 
@@ -75,6 +75,13 @@ void gg_get_rand_state(struct gg_rand_state *state);
 /* Set the internal state of the random number generator. */
 void gg_set_rand_state(struct gg_rand_state *state);
 
+/* Reentrant versions of gg_srand(), gg_urand() and gg_drand() working
+ * on a state kept by the caller.
+ */
+void gg_srand_r(struct gg_rand_state *state, unsigned int seed);
+unsigned int gg_urand_r(struct gg_rand_state *state);
+double gg_drand_r(struct gg_rand_state *state);
+
 
 #endif /* _RANDOM_H_ */
 